@@ -1,10 +1,7 @@
 #pragma once
-#include <spin-lock.h>
-
 #include <atomic>
-#include <condition_variable>
+#include <cstdint>
 #include <memory>
-#include <mutex>
 
 #define AUDIO_CHUNK_SAMPLES 128
 #define AUDIO_SAMPLE_RATE 44100
@@ -15,26 +12,65 @@ struct audio_chunk {
 };
 
 /**
- * \class 
- * \brief This class provides a thread-safe circular audio buffer 
- * 
- * The buffer can be used by both worklet and worker threads simultaneously.
+ * \class
+ * \brief This class provides a wait-free single-producer/single-consumer
+ *        circular audio buffer
+ *
+ * The mixer (worker) thread is the only producer and the worklet thread is
+ * the only consumer. Neither of them ever takes a lock: the read index is
+ * written by the consumer only, the write index by the producer only.
+ *
+ * `clear()` may be called from any thread. It does not touch the indices,
+ * it only bumps the reset epoch. Every slot is tagged with the epoch it was
+ * acquired in and the consumer silently drops slots from older epochs.
+ *
+ * Besides the copying stream operators, both sides can work on the ring
+ * storage in place: the producer renders straight into a slot obtained
+ * from `acquire_write_slot()` and publishes it with `commit_write_slot()`,
+ * the consumer reads a slot from `acquire_read_slot()` and hands it back
+ * with `release_read_slot()`.
+ *
+ * The storage is allocated for the full capacity up front, but the producer
+ * only runs `depth()` samples ahead of the consumer. The depth can be
+ * changed at any time to trade latency for underflow safety.
  */
 class AudioBuffer {
 public:
     AudioBuffer(int sampleSize);
 
     int underflow_count() const;
+    int capacity() const;
+    int depth() const;
+    void set_depth(int samples);
     bool operator>>(audio_chunk& target);
     AudioBuffer& operator<<(const audio_chunk& source);
     void clear();
 
+    // Producer side, waits until there is a free slot
+    audio_chunk& acquire_write_slot();
+    void commit_write_slot();
+
+    // Consumer side, never blocks. Returns nullptr on underflow.
+    const audio_chunk* acquire_read_slot();
+    void release_read_slot();
+
 private:
-    std::unique_ptr<audio_chunk[]> _chunk_array;
+    struct slot {
+        audio_chunk chunk;
+        uint32_t epoch;
+    };
+
+    std::unique_ptr<slot[]> _slot_array;
     int _array_size;
+    std::atomic_int _depth_chunks;
     std::atomic_int _underflow_count;
-    std::atomic_int _read_idx;
-    std::atomic_int _write_idx;
-    std::atomic_int _reset_counter;
-    SpinLock _read_lock, _write_lock;
+    std::atomic<uint32_t> _epoch;
+    uint32_t _last_read_epoch; // consumer only
+
+    // Both indices live on separate cache lines so that the producer and
+    // the consumer do not keep invalidating each other's line
+    alignas(64) std::atomic_int _read_idx;
+    alignas(64) std::atomic_int _write_idx;
+
+    int next_index(int index) const;
 };
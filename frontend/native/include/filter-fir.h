@@ -1,12 +1,24 @@
 #pragma once
+#include <algorithm>
 #include <array>
-#include <functional>
+#include <cstddef>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 /**
  * \class
- * 
+ *
  * \brief A template class that implements a simple FIR filter
- * 
+ *
+ * The history is stored twice in a row (every sample is written at `i` and
+ * `i + taps`), so the last `taps` samples are always a contiguous window and
+ * the convolution is a plain dot product with the reversed coefficients.
+ * Blocks are filtered several outputs at a time instead, see process().
+ *
  * \tparam taps number of taps the filter has (and its internal history
  *              buffer size)
  */
@@ -16,44 +28,148 @@ public:
     FIRFilter(const std::array<float, taps>& coefficients)
         : _history_index(0)
     {
-        for (int i = 0; i < taps; ++i) _coeffs[i] = coefficients[i];
+        for (size_t i = 0; i < taps; ++i) _coeffs[i] = coefficients[taps - 1 - i];
         _history.fill(0.f);
     }
 
     float operator()(float in_sample)
     {
-        _history[_history_index++] = in_sample;
-        if (_history_index >= taps) {
-            _history_index -= taps;
+        push(in_sample);
+        return convolve(&_history[_history_index]);
+    }
+
+    /* Filters `n` samples, `in` and `out` may be the same buffer */
+    void process(const float* in, float* out, size_t n)
+    {
+        while (n > 0) {
+            size_t block = n < BLOCK_SAMPLES ? n : BLOCK_SAMPLES;
+            process_block(in, out, block);
+
+            in += block;
+            out += block;
+            n -= block;
         }
+    }
 
-        // Convolve
-        float output_sample = 0.f;
-        int current_history_index = _history_index;
+private:
+    static constexpr size_t BLOCK_SAMPLES = 128;
 
-        // We prefer speed over binary size
-        loop_unroll<taps>([&](int i) {
-            output_sample += _coeffs[i] * _history[current_history_index--];
+    // Coefficients in reverse order, oldest sample first
+    std::array<float, taps> _coeffs;
+    std::array<float, 2 * taps> _history;
+    size_t _history_index;
 
-            if (current_history_index < 0) { // This should be faster than modulo
-                current_history_index += taps;
-            }
-        });
+    // Last `taps - 1` samples before the block followed by the block itself
+    std::array<float, taps - 1 + BLOCK_SAMPLES> _block;
 
-        return output_sample;
+    void push(float in_sample)
+    {
+        _history[_history_index] = in_sample;
+        _history[_history_index + taps] = in_sample;
+
+        if (++_history_index >= taps) {
+            _history_index = 0;
+        }
     }
 
-private:
-    std::array<float, taps> _coeffs;
-    std::array<float, taps> _history;
-    unsigned long _history_index;
+    void process_block(const float* in, float* out, size_t n)
+    {
+        std::copy(&_history[_history_index + 1], &_history[_history_index + taps], _block.begin());
+        std::copy(in, in + n, _block.begin() + taps - 1);
+
+        // Output `i` is the dot product of the coefficients with
+        // _block[i, i + taps). Each coefficient is splat against 4
+        // neighbouring samples, and 4 such groups are summed independently
+        // so the additions don't wait on each other.
+        size_t scalar_outputs_start = 0;
 
-    template <int N, typename FunType, int i = 0>
-    void loop_unroll(FunType loop_body) {
-        if constexpr (i < N) {
-            loop_body(i);
-            loop_unroll<N, FunType, i + 1>(loop_body);
+#if defined(__wasm_simd128__)
+        scalar_outputs_start = n - n % 16;
+
+        for (size_t i = 0; i < n - n % 16; i += 16) {
+            v128_t sum[4] = { wasm_f32x4_splat(0.f), wasm_f32x4_splat(0.f),
+                wasm_f32x4_splat(0.f), wasm_f32x4_splat(0.f) };
+            for (size_t t = 0; t < taps; ++t) {
+                v128_t coeff = wasm_f32x4_splat(_coeffs[t]);
+                for (int g = 0; g < 4; ++g) {
+                    sum[g] = wasm_f32x4_add(sum[g],
+                        wasm_f32x4_mul(coeff, wasm_v128_load(&_block[i + 4 * g + t])));
+                }
+            }
+
+            for (int g = 0; g < 4; ++g) {
+                wasm_v128_store(out + i + 4 * g, sum[g]);
+            }
         }
+#elif defined(__SSE2__)
+        scalar_outputs_start = n - n % 16;
+
+        for (size_t i = 0; i < n - n % 16; i += 16) {
+            __m128 sum[4] = { _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps(), _mm_setzero_ps() };
+            for (size_t t = 0; t < taps; ++t) {
+                __m128 coeff = _mm_set1_ps(_coeffs[t]);
+                for (int g = 0; g < 4; ++g) {
+                    sum[g] = _mm_add_ps(sum[g], _mm_mul_ps(coeff, _mm_loadu_ps(&_block[i + 4 * g + t])));
+                }
+            }
+
+            for (int g = 0; g < 4; ++g) {
+                _mm_storeu_ps(out + i + 4 * g, sum[g]);
+            }
+        }
+#endif
+
+        // Remainder (or everything if there's no SIMD support)
+        for (size_t i = scalar_outputs_start; i < n; ++i) {
+            float output_sample = 0.f;
+            for (size_t t = 0; t < taps; ++t) {
+                output_sample += _coeffs[t] * _block[i + t];
+            }
+            out[i] = output_sample;
+        }
+
+        // The last `taps` samples become the history, oldest first
+        const float* last = &_block[n - 1];
+        std::copy(last, last + taps, _history.begin());
+        std::copy(last, last + taps, _history.begin() + taps);
+        _history_index = 0;
     }
 
+    float convolve(const float* window) const
+    {
+        // Taps handled 4 at a time when there's SIMD support
+        size_t scalar_taps_start = 0;
+        float output_sample = 0.f;
+
+#if defined(__wasm_simd128__)
+        scalar_taps_start = taps - taps % 4;
+
+        v128_t sum = wasm_f32x4_splat(0.f);
+        for (size_t i = 0; i < taps - taps % 4; i += 4) {
+            sum = wasm_f32x4_add(sum,
+                wasm_f32x4_mul(wasm_v128_load(&_coeffs[i]), wasm_v128_load(window + i)));
+        }
+
+        output_sample = wasm_f32x4_extract_lane(sum, 0) + wasm_f32x4_extract_lane(sum, 1)
+            + wasm_f32x4_extract_lane(sum, 2) + wasm_f32x4_extract_lane(sum, 3);
+#elif defined(__SSE2__)
+        scalar_taps_start = taps - taps % 4;
+
+        __m128 sum = _mm_setzero_ps();
+        for (size_t i = 0; i < taps - taps % 4; i += 4) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(&_coeffs[i]), _mm_loadu_ps(window + i)));
+        }
+
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, sum);
+        output_sample = lanes[0] + lanes[1] + lanes[2] + lanes[3];
+#endif
+
+        // Remainder (or everything if there's no SIMD support)
+        for (size_t i = scalar_taps_start; i < taps; ++i) {
+            output_sample += _coeffs[i] * window[i];
+        }
+
+        return output_sample;
+    }
 };
@@ -1,12 +1,44 @@
 #pragma once
 #include <atomic>
+#include <cstdint>
+#include <memory>
 
 // Forward declarations
 struct audio_chunk;
 
+/**
+ * \class
+ * \brief Master bus peak limiter
+ *
+ * In `REACTIVE` mode the gain follows the signal peaks with attack and
+ * release envelopes, so transients overshoot the threshold until the attack
+ * catches up, and whatever overshoots full scale is hard clipped. In
+ * `LOOKAHEAD` mode the signal is delayed, the gain ramps down over the
+ * lookahead window ahead of every peak (the attack time is ignored) and
+ * peaks between samples are detected too, so the output doesn't exceed the
+ * threshold. The delay is reported by `latency_samples()`.
+ *
+ * When stereo linked, one envelope follows the louder of both channels and
+ * the same gain is applied to both, so limiting doesn't shift the stereo
+ * image (and the envelope is computed once instead of twice).
+ *
+ * Changing the mode, the stereo linking or the lookahead time restarts
+ * the envelopes.
+ */
 class Limiter {
 public:
+    enum class Mode { REACTIVE, LOOKAHEAD };
+
     Limiter();
+    ~Limiter();
+
+    void set_mode(Mode mode);
+    Mode mode() const;
+    void set_lookahead_ms(double lookahead_ms);
+    double lookahead_ms() const;
+    void set_stereo_linked(bool linked);
+    bool stereo_linked() const;
+    uint32_t latency_samples() const;
 
     void set_attack_ms(double attack_ms);
     double attack_ms() const;
@@ -23,6 +55,7 @@ public:
     void apply(audio_chunk& chunk);
 
 private:
+    /* Knee and threshold in log2 units */
     struct limiter_settings {
         double attack;
         double attack_coeff;
@@ -33,7 +66,10 @@ private:
         double threshold;
     };
 
+    struct lookahead_state;
+
     static const double PEAK_DESCENT_RATE;
+    static const double LOOKAHEAD_MS_MAX;
 
     std::atomic<double> _attack_ms;
     std::atomic<double> _release_ms;
@@ -41,12 +77,26 @@ private:
     std::atomic<double> _ratio;
     std::atomic<double> _threshold_db;
     std::atomic<double> _reduction_db;
+    std::atomic<Mode> _mode;
+    std::atomic<double> _lookahead_ms;
+    std::atomic<bool> _stereo_linked;
 
     double _current_peak_l, _current_peak_r;
-    double _current_reduction_l, _current_reduction_r;
+    double _current_reduction_l, _current_reduction_r; // log2 units
+
+    // Audio thread only
+    Mode _active_mode;
+    bool _active_stereo_linked;
+    uint32_t _active_lookahead_samples;
+    std::unique_ptr<lookahead_state> _lookahead_l, _lookahead_r;
 
-    void process_sample(const limiter_settings& settings, 
-        float& sample, double& peak, double& reduction);
-    double calculate_target_db(const limiter_settings& settings, double input_db);
+    uint32_t lookahead_samples() const;
+    template <int channel_count>
+    void process_lookahead(const limiter_settings& settings, float* const* channels,
+        lookahead_state* const* states, double& reduction);
+    template <int channel_count>
+    void process_reactive(const limiter_settings& settings, float* const* channels,
+        double& peak, double& reduction);
+    double calculate_target(const limiter_settings& settings, double input);
     double milliseconds_to_ewma_coeff(double time_ms) const;
 };
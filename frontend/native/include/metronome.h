@@ -1,10 +1,22 @@
 #pragma once
 #include <stdint.h>
 
+#include <vector>
+
 // Forward declarations
 struct audio_chunk;
 class Tempo;
 
+/**
+ * \class
+ * \brief Renders the metronome ticks over the mixdown
+ *
+ * `process()` schedules the ticks of a chunk at their exact offsets from
+ * the tempo map and `render()` mixes them in. Click sounds are mono float
+ * samples at the output sample rate, the built-in ones are converted once
+ * when the metronome is created. Replacing a sound isn't synchronized with
+ * rendering, the caller has to make sure they don't run concurrently.
+ */
 class Metronome {
 public:
     Metronome(const Tempo& tempo);
@@ -12,19 +24,34 @@ public:
     void set_gain(double gain);
     double gain() const;
 
+    /* Replaces a click sound, an empty one restores the built-in sound */
+    void set_sound(bool bar_start, std::vector<float> samples);
+
     void process(uint32_t first_sample);
     void render(audio_chunk& chunk);
 
 private:
+    struct scheduled_tick {
+        int offset; // in the chunk
+        bool bar_start;
+    };
+
     static const uint8_t SOUND_BAR[];
     static const int SOUND_BAR_SAMPLES;
     static const uint8_t SOUND_BEAT[];
     static const int SOUND_BEAT_SAMPLES;
     static const int TICK_OFFSET;
+    static const int MAX_BEATS_PER_CHUNK;
 
     const Tempo& _tempo;
     double _gain;
-    const int16_t* _current_sample;
-    int _current_sample_length;
-    int _sample_position;
+    std::vector<float> _sound_bar;
+    std::vector<float> _sound_beat;
+    std::vector<scheduled_tick> _scheduled_ticks; // MAX_BEATS_PER_CHUNK
+    size_t _scheduled_tick_count;
+    bool _current_bar_start;
+    size_t _sample_position;
+
+    const std::vector<float>& sound(bool bar_start) const;
+    void mix_tick(audio_chunk& chunk, int start, int end);
 };
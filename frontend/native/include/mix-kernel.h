@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+/**
+ * \class
+ * \brief Mixing kernels used by the stem mixdown and the master bus
+ *
+ * The kernels use WebAssembly SIMD (or SSE2 on native builds) when the
+ * compiler targets it and fall back to the scalar versions otherwise. The
+ * scalar versions are always available for checking results.
+ */
+class MixKernel {
+public:
+    /*
+     * Adds `frames` interleaved int16 stereo frames from `source`, scaled by
+     * `gain_l` and `gain_r`, to the `left` and `right` float buses. Gains
+     * are expected to include the int16 -> float conversion factor.
+     */
+    static void mix_stereo(const int16_t* source, int frames,
+        float gain_l, float gain_r, float* left, float* right);
+    static void mix_stereo_scalar(const int16_t* source, int frames,
+        float gain_l, float gain_r, float* left, float* right);
+
+    /* Adds `count` mono float samples, scaled by `gain`, to both buses */
+    static void mix_mono(const float* source, int count, float gain, float* left, float* right);
+    static void mix_mono_scalar(const float* source, int count, float gain,
+        float* left, float* right);
+
+    /* Multiplies `count` samples in place by their per-sample `gains` */
+    static void apply_gain(float* samples, const float* gains, int count);
+    static void apply_gain_scalar(float* samples, const float* gains, int count);
+};
@@ -4,6 +4,8 @@
 #include <tempo.h>
 
 #include <memory>
+#include <mutex>
+#include <string>
 #include <thread>
 
 // Forward declarations
@@ -45,6 +47,8 @@ public:
     bool metronome_enabled() const;
     void set_metronome_gain_db(double gain);
     double metronome_gain_db() const;
+    // Mono samples at the output sample rate, empty for the built-in sound
+    void set_metronome_sound(bool bar_start, std::vector<float> samples);
 
     void set_track_bpm(double bpm, uint32_t time_sig_numerator = 4);
     void set_track_varying_bpm(const std::vector<tempo_tag>& tags);
@@ -61,6 +65,9 @@ public:
 
     uint32_t waveform_ordinal(uint32_t stem_id) const;
     std::string waveform_data_uri(uint32_t stem_id) const;
+    std::shared_ptr<const std::vector<uint8_t>> pin_waveform_image(uint32_t stem_id);
+    int waveform_width() const;
+    int waveform_height() const;
 
     void toggle_mute(uint32_t stem_id);
     void toggle_solo(uint32_t stem_id);
@@ -69,6 +76,24 @@ public:
     bool stem_soloed(uint32_t stem_id) const;
 
     double limiter_reduction_db() const;
+    void set_limiter_lookahead_enabled(bool enabled);
+    bool limiter_lookahead_enabled() const;
+    void set_limiter_stereo_linked(bool linked);
+    bool limiter_stereo_linked() const;
+    uint32_t limiter_latency_samples() const;
+
+    void set_mix_thread_count(uint32_t count);
+    uint32_t mix_thread_count() const;
+    uint32_t max_mix_thread_count() const;
+
+    void set_streaming_enabled(bool enabled);
+    bool streaming_enabled() const;
+
+    size_t background_queue_depth() const;
+    std::vector<task_class_stats> background_task_stats() const;
+
+    uint32_t buffer_depth() const;
+    std::string buffer_depth_reason() const;
 
 private:
     enum class PlaybackState {
@@ -95,6 +120,9 @@ private:
 
     SpinLock _mixdown_lock;
 
+    mutable std::mutex _buffer_depth_mutex;
+    std::string _buffer_depth_reason;
+
     StemManager _stems;
 
     void thread_main();
@@ -102,4 +130,7 @@ private:
     void apply_soft_start(audio_chunk& chunk);
     void apply_soft_stop(audio_chunk& chunk);
     void invalidate_state();
+    void grow_buffer_depth(int underflows);
+    void shrink_buffer_depth(int stable_checks);
+    void set_buffer_depth_reason(std::string reason);
 };
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * \class
+ * \brief Min/max mipmap of a stereo stem, used for drawing waveforms
+ *
+ * Level 0 holds the peaks of every `BASE_BLOCK_SAMPLES` samples, and every
+ * next level merges pairs of blocks of the previous one. A peak query over
+ * any range takes O(log n) blocks, so a waveform of any width or zoom can
+ * be drawn without touching the samples again.
+ */
+class PeakPyramid {
+public:
+    static const uint32_t BASE_BLOCK_SAMPLES = 64;
+
+    PeakPyramid();
+
+    void build(const int16_t* samples, uint32_t num_samples);
+    bool empty() const;
+    size_t memory_usage() const;
+
+    /*
+     * Returns the {high, low} peaks of samples [first_sample, last_sample),
+     * rounded outwards to whole level 0 blocks. A range that doesn't overlap
+     * the stem yields {INT16_MIN, INT16_MAX}.
+     */
+    std::pair<int16_t, int16_t> peaks(int64_t first_sample, int64_t last_sample) const;
+
+private:
+    struct block_peaks {
+        int16_t high;
+        int16_t low;
+    };
+
+    uint32_t _num_samples;
+    std::vector<std::vector<block_peaks>> _levels;
+};
@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * \class
+ * \brief PNG encoder specialized for images with few distinct colors
+ *
+ * Waveform images only use a handful of colors, so the fast modes write an
+ * indexed PNG (1 to 8 bits per pixel) without scanline filters. `STORED`
+ * doesn't compress at all, `FAST` only looks for runs and for repeats of
+ * the previous scanline and codes them with the fixed Huffman table. Both
+ * work in a single pass and their output size is bounded by the size of
+ * the indexed image. `COMPACT` is lodepng with its default settings.
+ *
+ * Images with more than 256 colors are always encoded by lodepng.
+ */
+class PngEncoder {
+public:
+    enum class Mode { COMPACT, STORED, FAST };
+
+    static std::vector<uint8_t> encode(const uint8_t* rgba, int width, int height, Mode mode);
+
+private:
+    static const size_t PALETTE_SIZE_MAX;
+
+    static bool build_indexed_image(const uint8_t* rgba, int width, int height,
+        std::vector<uint32_t>& palette, std::vector<uint8_t>& scanlines, int& bit_depth);
+    static void deflate_stored(const std::vector<uint8_t>& data, std::vector<uint8_t>& out);
+    static void deflate_fast(const std::vector<uint8_t>& data, size_t stride,
+        std::vector<uint8_t>& out);
+    static void write_chunk(std::vector<uint8_t>& png, const char* type,
+        const std::vector<uint8_t>& data);
+    static uint32_t crc32(const uint8_t* data, size_t size, uint32_t crc = 0);
+    static uint32_t adler32(const std::vector<uint8_t>& data);
+};
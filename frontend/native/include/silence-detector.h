@@ -1,14 +1,31 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
 #include <vector>
+
+// Remembers where the last lookup ended, see SilenceDetector::is_silent()
+struct silence_cursor {
+    size_t interval;
+    int32_t position;
+};
+
 class SilenceDetector{
 public:
     SilenceDetector();
     auto begin() const {return _silences.begin();}
     auto end() const {return _silences.end();}
     void detect_silence(const int16_t* stem,uint32_t total_length);
+
+    // Checks if [first_sample, first_sample + length) lies within a single
+    // silence interval. Binary search, O(log n).
+    bool is_silent(int32_t first_sample, int32_t length) const;
+    // Same as above, but amortized O(1) for sequential lookups. Falls back
+    // to a binary search when the position moves backwards (e.g. seek).
+    bool is_silent(int32_t first_sample, int32_t length, silence_cursor& cursor) const;
 private:
     int16_t _silence_threshold;
     uint32_t _silence_min_length;
     std::vector<std::pair<int32_t,int32_t>> _silences;
-};
\ No newline at end of file
+
+    size_t find_interval(int32_t last_sample) const;
+};
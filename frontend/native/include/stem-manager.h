@@ -1,17 +1,25 @@
 #pragma once
 #include <atomic>
 #include <functional>
+#include <memory>
 #include <mutex>
 #include <optional>
+#include <peak-pyramid.h>
 #include <string>
+#include <thread>
 #include <unordered_map>
 #include <unordered_set>
 #include <silence-detector.h>
+#include <task-scheduler.h>
 #include <vector>
+#include <waveform-renderer.h>
 
 
 // Forward declarations
 struct audio_chunk;
+class StemStream;
+class VorbisArenaPool;
+class WorkerPool;
 
 
 struct stem_info {
@@ -32,6 +40,7 @@ struct stem_info {
 class StemManager {
 public:
     StemManager();
+    ~StemManager();
 
     void set_track_length(uint32_t samples);
     uint32_t track_length() const;
@@ -48,33 +57,77 @@ public:
     uint32_t waveform_ordinal(uint32_t stem_id) const;
     std::string waveform_data_uri(uint32_t stem_id) const;
 
+    /* RGBA image, empty while the waveform is being (re)rendered */
+    std::shared_ptr<const std::vector<uint8_t>> waveform_image(uint32_t stem_id) const;
+    /*
+     * Same as above, but the stem also keeps the returned image alive until
+     * the next call or until the stem is removed. Meant for views that point
+     * straight into the image.
+     */
+    std::shared_ptr<const std::vector<uint8_t>> pin_waveform_image(uint32_t stem_id);
+    int waveform_width() const;
+    int waveform_height() const;
+
     /* Bear in mind that the callback will be called from the worker thread! */
     void set_bg_task_complete_callback(std::function<void()> callback);
 
+    /* Number of threads (including the mixer thread) sharing the mixdown */
+    void set_mix_thread_count(uint32_t count);
+    uint32_t mix_thread_count() const;
+    uint32_t max_mix_thread_count() const;
+
+    /* Applies to stems loaded after the call */
+    void set_streaming_enabled(bool enabled);
+    bool streaming_enabled() const;
+
+    size_t background_queue_depth() const;
+    std::vector<task_class_stats> background_task_stats() const;
+
     void render(uint32_t first_sample, audio_chunk& chunk);
     void update_stem_info(const std::vector<stem_info>& info);
 private:
+    /* Column peaks of the last full waveform render, reused on offset changes */
+    struct waveform_columns {
+        int32_t offset;
+        uint32_t track_length;
+        WaveformRenderer::ColumnPeaks peaks;
+    };
+
     struct StemEntry {
         stem_info info;
         std::mutex mutex;
         std::atomic_bool data_ready;
+        // while downloading, the prefix up to this sample is already playable
+        std::atomic<uint32_t> decoded_samples;
         std::atomic_bool deleted;
         std::atomic_bool error;
         float gain;
         // do not use this string, it only owns 
         // a binary data block, use `.data` instead
-        std::string data_block; 
+        std::shared_ptr<std::string> data_block; 
         
         const int16_t* data;
+        // set instead of `data` when the stem is played in streaming mode
+        std::unique_ptr<StemStream> stream;
         std::atomic<uint32_t> waveform_ordinal;
-        std::string waveform_base64;
+        std::shared_ptr<const std::vector<uint8_t>> waveform_image;
+        std::shared_ptr<const std::vector<uint8_t>> pinned_waveform_image;
+        std::shared_ptr<const waveform_columns> columns;
         SilenceDetector detector;
+        silence_cursor detector_cursor; // used by the mixer only
+        PeakPyramid peaks;
     };
 
     using StemEntryPtr = std::shared_ptr<StemEntry>;
 
     static const float SHORT_TO_FLOAT;
     static const int STEM_DOWNLOAD_RETRY_COUNT;
+    static const uint64_t STEM_DOWNLOAD_CHUNK_MIN;
+    static const uint64_t STEM_DOWNLOAD_CHUNK_MAX;
+    static const size_t MIX_STEMS_PER_THREAD_MIN;
+    static const int STREAM_FILL_BLOCK_FRAMES;
+    static const int WAVEFORM_WIDTH;
+    static const int WAVEFORM_HEIGHT;
 
     /*
      * Locking strategy: because concurrent reads from STL containers are
@@ -87,19 +140,47 @@ private:
     std::atomic<uint32_t> _length;
     std::unordered_map<uint32_t, StemEntryPtr> _stems;
     std::function<void()> _complete_cb;
+    std::unique_ptr<TaskScheduler> _tasks;
+    std::unique_ptr<WorkerPool> _waveform_pool;
+    // Shared with the decoders, which may outlive the manager in a task
+    std::shared_ptr<VorbisArenaPool> _decoder_arenas;
 
     std::unordered_set<uint32_t> _muted_stems;
     std::optional<uint32_t> _soloed_stem;
 
+    /*
+     * Parallel mixdown: audible stems are sorted by id and split into
+     * contiguous groups, each rendered into its own partial bus. The buses
+     * are summed in group order, so the result doesn't depend on which
+     * thread happened to render which group.
+     */
+    std::unique_ptr<WorkerPool> _mix_pool;
+    std::atomic<uint32_t> _mix_thread_count;
+    std::vector<StemEntry*> _render_list; // guarded by _mutex
+    std::unique_ptr<audio_chunk[]> _partial_buses;
+
+    /*
+     * Streaming mode: stems keep only their compressed data, and a single
+     * background thread keeps the decoded window of each one ahead of
+     * its playhead
+     */
+    std::atomic_bool _streaming_enabled;
+    std::atomic_bool _stopping;
+    std::thread _stream_thread;
+
+    void stream_thread_main();
+    void render_stem(StemEntry& stem, uint32_t first_sample, audio_chunk& chunk);
     void switch_to_mute_mode();
 
     void erase_unused_stems(const std::vector<stem_info>& info);
     void update_or_add_stems(const std::vector<stem_info>& info);
     StemEntryPtr create_stem_from_info(const stem_info& info);
 
+    static TaskScheduler::CancellationToken cancellation_token(const StemEntryPtr& stem);
     void run_stem_processing(StemEntryPtr stem);
     void run_waveform_processing(StemEntryPtr stem, uint32_t prev_ordinal);
     void process_stem(StemEntryPtr stem);
-    bool decode_vorbis_stream(StemEntryPtr stem, const char* data, uint32_t data_size);
+    bool download_range(StemEntryPtr stem, uint64_t first_byte, uint64_t length, 
+        std::string& out, bool& last);
     void process_stem_waveform(StemEntryPtr stem, uint32_t prev_ordinal);
 };
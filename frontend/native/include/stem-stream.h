@@ -0,0 +1,65 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward declarations
+struct stb_vorbis;
+class VorbisArenaPool;
+
+/**
+ * \class
+ * \brief Decodes a stem on the fly from its compressed Ogg Vorbis data
+ *
+ * Instead of the whole decoded stem, only a window of `RING_FRAMES` frames
+ * is kept in memory. The mixer publishes its playhead and reads the frames
+ * it needs, while a background thread calls `fill()` to keep the window
+ * ahead of the playhead and to refill it after a seek.
+ *
+ * Synchronization: the decoder moves the window start forward before it
+ * overwrites any ring slot and then re-checks the playhead; the mixer
+ * publishes the playhead before it checks the window. Both sides use
+ * sequentially consistent atomics, so either the decoder sees the playhead
+ * and leaves its frames alone, or the mixer sees the moved window and
+ * doesn't read the slots being overwritten.
+ */
+class StemStream {
+public:
+    StemStream(std::string compressed_data, uint32_t total_frames,
+        std::shared_ptr<VorbisArenaPool> arenas);
+    ~StemStream();
+
+    bool open();
+    const std::string& compressed_data() const;
+    size_t memory_usage() const;
+
+    // Mixer side. `set_playhead()` must be called once per quantum before
+    // `acquire()`. `acquire()` returns the number of contiguous frames
+    // available at `first_frame` (0 if they aren't decoded yet).
+    void set_playhead(int32_t frame);
+    int acquire(int32_t first_frame, int frames, const int16_t*& data) const;
+
+    // Decoder side. Returns true if there was anything to do.
+    bool fill(int max_frames);
+
+private:
+    static const int32_t RING_FRAMES;
+    static const int32_t SEEK_DISTANCE_FRAMES;
+    static const int32_t READ_AHEAD_MARGIN_FRAMES;
+
+    std::string _compressed_data;
+    int32_t _total_frames;
+    std::shared_ptr<VorbisArenaPool> _arenas;
+    std::vector<char> _arena;
+    stb_vorbis* _vorbis;
+    std::unique_ptr<int16_t[]> _ring;
+
+    std::atomic<int32_t> _playhead;
+    std::atomic<int32_t> _window_start;
+    std::atomic<int32_t> _window_end;
+
+    void seek(int32_t frame);
+    int32_t decode_into_ring(int32_t first_frame, int32_t last_frame);
+};
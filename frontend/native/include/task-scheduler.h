@@ -0,0 +1,91 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+struct task_class_stats {
+    std::string name;
+    uint32_t queued;
+    uint32_t running;
+    uint32_t completed;
+    uint32_t cancelled;
+    uint32_t coalesced;
+    double average_wait_ms;
+    double average_run_ms;
+    double max_run_ms;
+};
+
+/**
+ * \class
+ * \brief Runs background tasks on a fixed number of worker threads
+ *
+ * Queued tasks are picked strictly by priority class and in submission
+ * order within a class. A task whose cancellation token is set by the time
+ * it gets picked is dropped without running. Coalesced tasks replace the
+ * queued task with the same key, so only the latest one of a series of
+ * superseded jobs actually runs.
+ *
+ * On destruction, running tasks are waited for and queued ones dropped.
+ */
+class TaskScheduler {
+public:
+    // Declaration order is the priority order
+    enum class Priority { DECODE, WAVEFORM };
+
+    using Task = std::function<void()>;
+    using CancellationToken = std::shared_ptr<const std::atomic_bool>;
+
+    TaskScheduler(size_t thread_count);
+    ~TaskScheduler();
+
+    void submit(Priority priority, Task task, CancellationToken token = nullptr);
+    void submit_coalesced(Priority priority, uint64_t key, Task task,
+        CancellationToken token = nullptr);
+
+    size_t thread_count() const;
+    size_t queue_depth() const;
+    std::vector<task_class_stats> stats() const;
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    static const size_t PRIORITY_COUNT = 2;
+    static const char* const PRIORITY_NAMES[PRIORITY_COUNT];
+
+    struct queued_task {
+        Task task;
+        CancellationToken token;
+        std::optional<uint64_t> key;
+        Clock::time_point submitted;
+    };
+
+    struct class_counters {
+        uint32_t running = 0;
+        uint32_t completed = 0;
+        uint32_t cancelled = 0;
+        uint32_t coalesced = 0;
+        double total_wait_ms = 0;
+        double total_run_ms = 0;
+        double max_run_ms = 0;
+    };
+
+    mutable std::mutex _mutex;
+    std::condition_variable _cv;
+    bool _stopping;
+    std::deque<queued_task> _queues[PRIORITY_COUNT];
+    class_counters _counters[PRIORITY_COUNT];
+    std::vector<std::thread> _threads;
+
+    void enqueue(Priority priority, queued_task task);
+    void thread_main();
+};
@@ -1,6 +1,9 @@
 #pragma once
+#include <atomic>
 #include <cstdint>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <vector>
 
 struct tempo_tag {
@@ -18,16 +21,30 @@ struct song_position {
     bool operator!=(const song_position&) const = default;
 };
 
+struct beat_event {
+    uint32_t sample;
+    bool bar_start; // first beat of a bar
+};
+
 /**
  * \class
  * \brief This class keeps track of current BPM, time signature and
  *        track position.
  * 
  * It supports both stable and varying BPM types.
+ *
+ * Every tempo map comes with a precomputed grid of its beats, a beat being
+ * the first sample at which `current_position()` reports a new step.
+ * The tempo definition is an immutable snapshot behind an atomic pointer,
+ * so queries never lock and can't be blocked by a concurrent update. Every
+ * update publishes a new snapshot and the old ones are freed by a later
+ * update (or the destructor) once no query is in flight, so the audio
+ * thread never frees memory either.
  */
 class Tempo {
 public:
     Tempo();
+    ~Tempo();
 
     void set_stable_bpm(double bpm, uint32_t time_signature_numerator);
     void set_varying_bpm(const std::vector<tempo_tag>& tempo_def);
@@ -40,29 +57,78 @@ public:
 
     uint32_t bar_sample(uint32_t bar) const;
 
+    /*
+     * Writes the beats in [first_sample, last_sample) to `beats` in order, up
+     * to `max_beats` of them, and returns how many were written. Doesn't
+     * allocate, so it's safe to call from the audio thread.
+     */
+    size_t beats_in_range(uint32_t first_sample, uint32_t last_sample,
+        beat_event* beats, size_t max_beats) const;
+
 private:
     enum class TempoMode { STABLE, VARYING };
     static const int TICKS_PER_STEP;
 
-    mutable std::mutex _mutex;
+    /*
+     * Steps evenly spread over `sample_delta` samples from `start_sample`,
+     * `step_delta` steps per `sample_delta` samples. Stable tempo is a single
+     * segment that never ends, and so is the last segment of a varying map.
+     */
+    struct beat_segment {
+        uint32_t start_sample;
+        double sample_delta;
+        double step_delta;
+        uint32_t time_sig;
+    };
+
+    struct tempo_map {
+        TempoMode mode;
+        double stable_bpm;
+        double stable_samples_per_beat;
+        uint32_t stable_time_sig;
+        std::vector<tempo_tag> varying_bpm;
+        mutable std::atomic<uint32_t> last_varying_segment; // for optimization purposes
+
+        // Beats before `open_segment_from`, then the beats of `open_segment`
+        std::vector<beat_event> beat_grid;
+        std::optional<beat_segment> open_segment;
+        uint32_t open_segment_from;
+    };
 
-    TempoMode _mode;
-    double _stable_bpm;
-    double _stable_samples_per_beat;
-    uint32_t _stable_time_sig;
-    std::vector<tempo_tag> _varying_bpm;
-    mutable uint32_t _last_varying_segment; // for optimization purposes
+    std::atomic<const tempo_map*> _map;
+    mutable std::atomic<uint32_t> _active_readers;
+
+    std::mutex _writer_mutex;
+    std::vector<std::unique_ptr<const tempo_map>> _retired_maps;
+
+    void publish(std::unique_ptr<tempo_map> map);
+
+    template <typename Function>
+    auto read(Function function) const
+    {
+        // Pairs with the check in publish(): a snapshot is only freed after
+        // the counter has been seen at zero following its replacement
+        _active_readers.fetch_add(1);
+        auto result = function(*_map.load());
+        _active_readers.fetch_sub(1, std::memory_order_release);
+
+        return result;
+    }
 
     static double samples_per_beat_from_bpm(double bpm);
 
-    song_position stable_current_position(uint32_t track_position) const;
-    uint32_t stable_bar_sample(uint32_t bar) const;
+    static void build_beat_grid(tempo_map& map);
+    static uint32_t segment_whole_steps(const beat_segment& segment, uint32_t sample);
+    static uint32_t segment_step_sample(const beat_segment& segment, uint32_t step);
+
+    static song_position stable_current_position(const tempo_map& map, uint32_t track_position);
+    static uint32_t stable_bar_sample(const tempo_map& map, uint32_t bar);
 
-    size_t varying_bpm_binsearch(
-        size_t start, size_t end, uint32_t track_position) const;
-    size_t varying_find_segment_index(uint32_t track_position) const;
-    double varying_current_bpm(uint32_t track_position) const;
-    uint32_t varying_current_time_signature(uint32_t track_position) const;
-    song_position varying_current_position(uint32_t track_position) const;
-    uint32_t varying_bar_sample(uint32_t bar) const;
+    static size_t varying_bpm_binsearch(const tempo_map& map,
+        size_t start, size_t end, uint32_t track_position);
+    static size_t varying_find_segment_index(const tempo_map& map, uint32_t track_position);
+    static double varying_current_bpm(const tempo_map& map, uint32_t track_position);
+    static uint32_t varying_current_time_signature(const tempo_map& map, uint32_t track_position);
+    static song_position varying_current_position(const tempo_map& map, uint32_t track_position);
+    static uint32_t varying_bar_sample(const tempo_map& map, uint32_t bar);
 };
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <stb_vorbis.h>
+#include <vector>
+
+/**
+ * \class
+ * \brief Reusable memory arenas for stb_vorbis decoders
+ *
+ * A decoder opened with an `stb_vorbis_alloc` arena takes its setup tables
+ * and its per-frame temporary buffers from the arena instead of malloc()
+ * and alloca(), so opening and running a decoder in a recycled arena
+ * doesn't touch the heap at all.
+ *
+ * New arenas are sized for the largest decoder opened so far (its
+ * `setup_memory_required` plus temporary memory). If a decoder doesn't
+ * fit, it's opened again in a larger arena.
+ */
+class VorbisArenaPool {
+public:
+    using OpenFunction = std::function<stb_vorbis*(const stb_vorbis_alloc* alloc, int* error)>;
+
+    VorbisArenaPool();
+
+    /*
+     * Opens a decoder by calling `open_function` with an arena, possibly
+     * more than once. `arena` is taken from the pool if it's empty and
+     * stays with the caller until it's given back with `release()`, after
+     * the decoder has been closed.
+     */
+    stb_vorbis* open(std::vector<char>& arena, int& error, const OpenFunction& open_function);
+    void release(std::vector<char> arena);
+
+    uint32_t allocated_arena_count() const;
+
+private:
+    static const size_t ARENA_SIZE_MIN;
+    static const size_t ARENA_SIZE_MAX;
+    static const size_t IDLE_ARENAS_MAX;
+
+    mutable std::mutex _mutex;
+    std::vector<std::vector<char>> _idle_arenas;
+    size_t _arena_size;
+    uint32_t _allocated_arena_count;
+
+    void grow(size_t arena_size);
+    std::vector<char> acquire();
+};
@@ -0,0 +1,42 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Forward declarations
+struct stb_vorbis;
+class VorbisArenaPool;
+
+/**
+ * \class
+ * \brief Incrementally decodes an Ogg Vorbis file as its bytes arrive
+ *
+ * Bytes can be fed in arbitrary pieces. Every complete Vorbis frame gets
+ * decoded right away into the interleaved stereo int16 output buffer,
+ * incomplete data is kept until the next `feed()`. The decoder state lives
+ * in an arena from `arenas`.
+ */
+class VorbisPushDecoder {
+public:
+    VorbisPushDecoder(int16_t* output, uint32_t frames, std::shared_ptr<VorbisArenaPool> arenas);
+    ~VorbisPushDecoder();
+
+    VorbisPushDecoder(const VorbisPushDecoder&) = delete;
+    VorbisPushDecoder& operator=(const VorbisPushDecoder&) = delete;
+
+    bool feed(const char* data, size_t size);
+    uint32_t decoded_frames() const;
+
+private:
+    std::shared_ptr<VorbisArenaPool> _arenas;
+    std::vector<char> _arena;
+    stb_vorbis* _vorbis;
+    std::string _pending;
+    int16_t* _output;
+    uint32_t _capacity;
+    uint32_t _decoded;
+
+    void write_frames(float** channels, int channel_count, int frames);
+};
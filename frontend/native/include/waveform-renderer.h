@@ -1,14 +1,27 @@
 #pragma once
+#include <array>
 #include <cstdint>
+#include <functional>
 #include <utility>
 #include <vector>
+#include "png-encoder.h"
 #include "silence-detector.h"
 
+// Forward declarations
+class PeakPyramid;
+class WorkerPool;
+
 class WaveformRenderer {
 public:
+    /* {high, low} peak of every image column */
+    using ColumnPeaks = std::vector<std::pair<int16_t, int16_t>>;
+
     WaveformRenderer(SilenceDetector& detector);
     WaveformRenderer(int width, int height,SilenceDetector& detector);
 
+    /* Columns are split across the pool whenever it isn't busy */
+    void set_worker_pool(WorkerPool* pool);
+
     void set_silence_alpha(uint8_t alpha);
     uint8_t silence_alpha() const;
     void set_waveform_color(uint8_t red, uint8_t green, uint8_t blue, uint8_t alpha);
@@ -21,8 +34,21 @@ public:
     void set_silence_min_length(uint32_t min_length_samples);
     uint32_t silence_min_length() const;
 
-    std::vector<uint8_t> render_waveform_to_png(int32_t offset, uint32_t total_length,
-        const int16_t* samples, uint32_t num_samples);
+    ColumnPeaks compute_column_peaks(int32_t offset, uint32_t total_length, 
+        const PeakPyramid& peaks);
+    ColumnPeaks shift_column_peaks(const ColumnPeaks& columns, int32_t columns_offset,
+        int32_t offset, uint32_t total_length, const PeakPyramid& peaks);
+
+    /* Returns a `width * height` RGBA image, rows top to bottom */
+    std::vector<uint8_t> render_waveform(int32_t offset, uint32_t total_length,
+        const PeakPyramid& peaks, uint32_t num_samples);
+    std::vector<uint8_t> render_waveform(int32_t offset, uint32_t total_length,
+        const ColumnPeaks& columns, uint32_t num_samples);
+    static std::vector<uint8_t> encode_png(const std::vector<uint8_t>& image, int width, int height,
+        PngEncoder::Mode mode = PngEncoder::Mode::FAST)
+    {
+        return PngEncoder::encode(image.data(), width, height, mode);
+    }
 
 private:
     struct __attribute__((packed)) pixel {
@@ -32,22 +58,33 @@ private:
         uint8_t alpha;
     };
 
+    /* Silence overlay blend, indexed by source alpha. Colors are scaled in 16.16 fixed point */
+    struct silence_blend {
+        std::array<uint8_t, 256> alpha;
+        std::array<uint32_t, 256> color_scale;
+    };
+
+    static const int PARALLEL_COLUMNS_PER_TASK;
+
     int _output_width, _output_height;
     uint8_t _color_red, _color_green, _color_blue, _color_alpha;
     uint8_t _silence_alpha;
     int16_t _silence_threshold;
     uint32_t _silence_min_length;
     SilenceDetector& _silence_detector;
+    WorkerPool* _pool;
 
-    void process_waveform(pixel* image, int32_t offset, uint32_t total_length,
-        const int16_t* samples, uint32_t num_samples);
+    void process_waveform(pixel* image, const ColumnPeaks& columns);
     void process_silence(pixel* image, int32_t offset, int32_t total_length,
-        const int16_t* samples, int32_t num_samples);
-    void draw_silence(pixel* image, uint32_t total_length, int& column, 
-        uint32_t silence_start, uint32_t silence_end);
-    void blend_pixel(pixel& src, const pixel& over);
+        int32_t num_samples);
+    void mark_silence(std::vector<uint8_t>& silent_columns, uint32_t total_length, 
+        int& column, uint32_t silence_start, uint32_t silence_end);
+    void for_each_column_range(const std::function<void(int, int)>& function);
+    silence_blend make_silence_blend() const;
     std::pair<int16_t, int16_t> get_column_peaks(uint32_t start_sample, uint32_t end_sample,
-        int32_t offset, const int16_t* samples, uint32_t num_samples);
+        int32_t offset, const PeakPyramid& peaks);
+    std::pair<int16_t, int16_t> get_column_peaks_at(int x, uint32_t total_length,
+        int32_t offset, const PeakPyramid& peaks);
     uint32_t get_column_end_sample(int x, uint32_t total_length) const;
     int peak_to_pixel(int16_t peak) const;
 }; 
@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+/**
+ * \class
+ * \brief A persistent fork-join pool for short data-parallel jobs
+ *
+ * `run()` hands out task indices to the pool threads and to the calling
+ * thread, and returns once every task has finished. Threads are started
+ * once and parked on an atomic between jobs, so dispatching a job neither
+ * allocates nor creates threads, which makes it usable from the mixer
+ * thread.
+ *
+ * Only one thread at a time may call `run()` on a given pool. Pools shared
+ * by several threads use `try_run()` instead, which returns false without
+ * running anything if the pool is already busy.
+ */
+class WorkerPool {
+public:
+    WorkerPool(size_t thread_count);
+    ~WorkerPool();
+
+    size_t thread_count() const;
+
+    template <typename FunType>
+    void run(size_t task_count, FunType& task)
+    {
+        dispatch(task_count, &task, [](void* context, size_t index) {
+            (*static_cast<FunType*>(context))(index);
+        });
+    }
+
+    template <typename FunType>
+    bool try_run(size_t task_count, FunType& task)
+    {
+        if (_busy.exchange(true, std::memory_order_acquire)) {
+            return false;
+        }
+
+        run(task_count, task);
+        _busy.store(false, std::memory_order_release);
+        return true;
+    }
+
+private:
+    using TaskFunction = void (*)(void*, size_t);
+
+    static const uint64_t CURSOR_INDEX_MASK;
+    static const int CURSOR_COUNT_SHIFT;
+    static const int CURSOR_GENERATION_SHIFT;
+
+    std::vector<std::thread> _threads;
+    std::atomic_bool _stopping;
+    std::atomic_bool _busy;
+
+    /*
+     * The cursor packs the job generation, its task count and the next
+     * unclaimed task index into a single word, so a late worker can never
+     * claim a task of a newer job with the parameters of an older one
+     */
+    std::atomic<uint64_t> _cursor;
+    std::atomic<uint32_t> _remaining;
+    void* _context;
+    TaskFunction _function;
+
+    void dispatch(size_t task_count, void* context, TaskFunction function);
+    void thread_main();
+    bool run_one_task();
+};
@@ -1,86 +1,158 @@
 #include <audio-buffer.h>
 
 #include <cassert>
-#include <cstdio>
-#include <thread>
+#include <cstring>
 
 
 AudioBuffer::AudioBuffer(int sampleSize)
     : _underflow_count(0)
+    , _epoch(0)
+    , _last_read_epoch(UINT32_MAX) // nothing was read yet
     , _read_idx(0)
     , _write_idx(0)
-    , _reset_counter(0)
 {
     assert(sampleSize > 0);
 
-    _array_size = sampleSize / AUDIO_CHUNK_SAMPLES;
+    int chunks = sampleSize / AUDIO_CHUNK_SAMPLES;
     if (sampleSize % AUDIO_CHUNK_SAMPLES) {
-        ++_array_size; // Make it ceil() instead of floor()
+        ++chunks; // Make it ceil() instead of floor()
     }
 
-    _chunk_array = std::make_unique<audio_chunk[]>(_array_size);
+    // One slot always stays empty to tell a full ring from an empty one
+    _array_size = chunks + 1;
+    _depth_chunks = chunks;
+
+    _slot_array = std::make_unique<slot[]>(_array_size);
 }
 
 int AudioBuffer::underflow_count() const
 {
-    return _underflow_count;
+    return _underflow_count.load(std::memory_order_relaxed);
 }
 
-bool AudioBuffer::operator>>(audio_chunk& target)
+int AudioBuffer::capacity() const
 {
-    std::lock_guard lock(_read_lock);
-    int current_read_idx = _read_idx.load();
+    return (_array_size - 1) * AUDIO_CHUNK_SAMPLES;
+}
 
-    if (current_read_idx == _write_idx) {
-        ++_underflow_count;
-        return false;
-    }
+int AudioBuffer::depth() const
+{
+    return _depth_chunks.load(std::memory_order_relaxed) * AUDIO_CHUNK_SAMPLES;
+}
 
-    memcpy(&target, &_chunk_array[current_read_idx], sizeof(audio_chunk));
+void AudioBuffer::set_depth(int samples)
+{
+    int chunks = (samples + AUDIO_CHUNK_SAMPLES - 1) / AUDIO_CHUNK_SAMPLES;
+    if (chunks < 1) chunks = 1;
+    if (chunks > _array_size - 1) chunks = _array_size - 1;
 
-    int next_cell = current_read_idx + 1;
-    if (next_cell >= _array_size) next_cell = 0;
+    // A shrunk depth takes effect once the consumer drains the surplus,
+    // a grown one as soon as the producer looks for a free slot again
+    _depth_chunks.store(chunks, std::memory_order_relaxed);
+}
 
-    _read_idx.compare_exchange_strong(current_read_idx, next_cell);
-    _read_idx.notify_one();
+bool AudioBuffer::operator>>(audio_chunk& target)
+{
+    const audio_chunk* source = acquire_read_slot();
+    if (source == nullptr) {
+        return false;
+    }
+
+    memcpy(&target, source, sizeof(audio_chunk));
+    release_read_slot();
     return true;
 }
 
 AudioBuffer& AudioBuffer::operator<<(const audio_chunk& source)
 {
-    std::unique_lock lock(_write_lock);
-    int current_write_idx = _write_idx;
+    memcpy(&acquire_write_slot(), &source, sizeof(audio_chunk));
+    commit_write_slot();
+    return *this;
+}
 
-    int next_cell = current_write_idx + 1;
-    if (next_cell >= _array_size) next_cell = 0;
+void AudioBuffer::clear()
+{
+    // Everything that is already queued becomes stale. The consumer drops
+    // stale slots on its own, so nothing has to be locked or zeroed here.
+    _epoch.fetch_add(1, std::memory_order_acq_rel);
+}
 
-    int previous_reset_counter = _reset_counter;
-    lock.unlock();
+audio_chunk& AudioBuffer::acquire_write_slot()
+{
+    int current_write_idx = _write_idx.load(std::memory_order_relaxed);
 
-    _read_idx.wait(next_cell);
+    while (true) {
+        int current_read_idx = _read_idx.load(std::memory_order_acquire);
+        int filled_chunks = current_write_idx - current_read_idx;
+        if (filled_chunks < 0) filled_chunks += _array_size;
 
-    lock.lock();
+        if (filled_chunks < _depth_chunks.load(std::memory_order_relaxed)) {
+            break;
+        }
 
-    if (previous_reset_counter == _reset_counter) {
-        memcpy(&_chunk_array[current_write_idx], &source, sizeof(audio_chunk));
-        _write_idx.compare_exchange_strong(current_write_idx, next_cell);
-    } else {
-        printf("[AudioBuffer] Omitting a single write to the circular buffer - reset detected!\n");
+        _read_idx.wait(current_read_idx, std::memory_order_acquire);
     }
 
-    return *this;
+    // The epoch is captured before anything is rendered into the slot, so
+    // a reset that happens in the middle of rendering discards this chunk
+    slot& current_slot = _slot_array[current_write_idx];
+    current_slot.epoch = _epoch.load(std::memory_order_acquire);
+    return current_slot.chunk;
 }
 
-void AudioBuffer::clear()
+void AudioBuffer::commit_write_slot()
 {
-    std::lock_guard lock(_read_lock);
-    std::lock_guard lock2(_write_lock);
+    int current_write_idx = _write_idx.load(std::memory_order_relaxed);
+    _write_idx.store(next_index(current_write_idx), std::memory_order_release);
+}
+
+const audio_chunk* AudioBuffer::acquire_read_slot()
+{
+    uint32_t epoch = _epoch.load(std::memory_order_acquire);
+    int initial_read_idx = _read_idx.load(std::memory_order_relaxed);
+    int current_read_idx = initial_read_idx;
+    int current_write_idx = _write_idx.load(std::memory_order_acquire);
+    const audio_chunk* result = nullptr;
+
+    // Skip the slots written before the last reset. There's at most
+    // `_array_size` of them, so this loop is bounded.
+    while (current_read_idx != current_write_idx) {
+        const slot& current_slot = _slot_array[current_read_idx];
+        if (current_slot.epoch == epoch) {
+            result = &current_slot.chunk;
+            break;
+        }
+
+        current_read_idx = next_index(current_read_idx);
+    }
 
-    for (int i = 0; i < _array_size; ++i) {
-        memset(&_chunk_array[i], 0, sizeof(audio_chunk));
+    if (result != nullptr) {
+        _last_read_epoch = epoch;
+    } else if (_last_read_epoch == epoch) {
+        // An empty ring right after a reset is expected, the producer
+        // simply didn't refill it yet. Don't count that as an underflow.
+        _underflow_count.fetch_add(1, std::memory_order_relaxed);
     }
 
-    ++_reset_counter;
-    _read_idx = _write_idx.load();
+    if (current_read_idx != initial_read_idx) {
+        // Give the stale slots back to the producer right away
+        _read_idx.store(current_read_idx, std::memory_order_release);
+        _read_idx.notify_one();
+    }
+
+    return result;
+}
+
+void AudioBuffer::release_read_slot()
+{
+    int current_read_idx = _read_idx.load(std::memory_order_relaxed);
+    _read_idx.store(next_index(current_read_idx), std::memory_order_release);
     _read_idx.notify_one();
 }
+
+int AudioBuffer::next_index(int index) const
+{
+    int next_cell = index + 1;
+    if (next_cell >= _array_size) next_cell = 0;
+    return next_cell;
+}
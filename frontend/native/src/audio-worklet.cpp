@@ -3,6 +3,8 @@
 #include <audio-buffer.h>
 #include <emscripten/webaudio.h>
 
+#include <cstring>
+
 
 uint8_t audio_thread_stack[4096];
 static const char* WORKLET_NODE_NAME = "glissando-processor";
@@ -31,7 +33,12 @@ AudioWorklet::~AudioWorklet()
 
 void AudioWorklet::process_audio(audio_chunk* output_buffer)
 {
-    if (_audio_buffer && (*_audio_buffer) >> (*output_buffer)) {
+    // Read the committed slot in place - the only copy left is the one
+    // into the output frame that Web Audio hands over to us
+    const audio_chunk* chunk = _audio_buffer ? _audio_buffer->acquire_read_slot() : nullptr;
+    if (chunk != nullptr) {
+        memcpy(output_buffer, chunk, sizeof(audio_chunk));
+        _audio_buffer->release_read_slot();
         return;
     }
 
@@ -74,18 +81,10 @@ void AudioWorklet::callback_audio_worklet_processor_created(
     // Setup audio path
     EM_ASM({
         const audioCtx = emscriptenGetAudioObject($1);
-        const clipperNode = new WaveShaperNode(audioCtx, {
-            curve: new Float32Array([-1, 1]),
-        });
-        // ^----- Apply clipping
-        const gainNode = new GainNode(audioCtx);
-        gainNode.gain.setValueAtTime(0.85, audioCtx.currentTime); 
-        // ^---- Windows mixer tries to apply its own limiting,
-        // especially if upsampling. Give him a bit of a headroom...
-
-        emscriptenGetAudioObject($0).connect(clipperNode);
-        clipperNode.connect(gainNode);
-        gainNode.connect(audioCtx.destination);
+
+        // The mixer's limiter keeps the true peak under its threshold, which
+        // also leaves headroom for resampling in the OS mixer
+        emscriptenGetAudioObject($0).connect(audioCtx.destination);
 
         window.audioContext = audioCtx;
         console.info(`Output sample rate is ${window.audioContext.sampleRate} Hz`);
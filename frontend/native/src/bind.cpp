@@ -1,5 +1,6 @@
 #include <mixer.h>
 #include <stem-manager.h>
+#include <task-scheduler.h>
 #include <tempo.h>
 
 #include <emscripten/bind.h>
@@ -7,6 +8,26 @@
 using namespace emscripten;
 extern Mixer* get_global_mixer();
 
+/*
+ * The returned view points straight into the wasm heap. The stem keeps the
+ * image behind it alive until the next call for the same stem or until the
+ * stem is removed, so JS must copy the pixels out before either happens.
+ */
+static val waveform_image_view(Mixer& mixer, uint32_t stem_id)
+{
+    auto image = mixer.pin_waveform_image(stem_id);
+    if (!image) {
+        return val(typed_memory_view<uint8_t>(0, nullptr));
+    }
+
+    return val(typed_memory_view(image->size(), image->data()));
+}
+
+static void set_metronome_sound(Mixer& mixer, bool bar_start, const val& samples)
+{
+    mixer.set_metronome_sound(bar_start, convertJSArrayToNumberVector<float>(samples));
+}
+
 
 EMSCRIPTEN_BINDINGS(editor) {
     function("getGlobalMixer", &get_global_mixer, allow_raw_pointer<Mixer>());
@@ -27,6 +48,7 @@ EMSCRIPTEN_BINDINGS(editor) {
         .function("isMetronomeEnabled", &Mixer::metronome_enabled)
         .function("setMetronomeGainDb", &Mixer::set_metronome_gain_db)
         .function("getMetronomeGainDb", &Mixer::metronome_gain_db)
+        .function("setMetronomeSound", &set_metronome_sound)
         .function("setTrackBpm", &Mixer::set_track_bpm)
         .function("setTrackVaryingBpm", &Mixer::set_track_varying_bpm)
         .function("getTrackBpm", &Mixer::track_bpm)
@@ -39,12 +61,29 @@ EMSCRIPTEN_BINDINGS(editor) {
         .function("updateStemInfo", &Mixer::update_stem_info)
         .function("getWaveformOrdinal", &Mixer::waveform_ordinal)
         .function("getWaveformDataUri", &Mixer::waveform_data_uri)
+        .function("getWaveformImage", &waveform_image_view)
+        .function("getWaveformWidth", &Mixer::waveform_width)
+        .function("getWaveformHeight", &Mixer::waveform_height)
         .function("toggleMute", &Mixer::toggle_mute)
         .function("toggleSolo", &Mixer::toggle_solo)
         .function("unmuteAll", &Mixer::unmute_all)
         .function("isStemMuted", &Mixer::stem_muted)
         .function("isStemSoloed", &Mixer::stem_soloed)
         .function("getLimiterReductionDb", &Mixer::limiter_reduction_db)
+        .function("setLimiterLookaheadEnabled", &Mixer::set_limiter_lookahead_enabled)
+        .function("isLimiterLookaheadEnabled", &Mixer::limiter_lookahead_enabled)
+        .function("setLimiterStereoLinked", &Mixer::set_limiter_stereo_linked)
+        .function("isLimiterStereoLinked", &Mixer::limiter_stereo_linked)
+        .function("getLimiterLatencySamples", &Mixer::limiter_latency_samples)
+        .function("setMixThreadCount", &Mixer::set_mix_thread_count)
+        .function("getMixThreadCount", &Mixer::mix_thread_count)
+        .function("getMaxMixThreadCount", &Mixer::max_mix_thread_count)
+        .function("setStreamingEnabled", &Mixer::set_streaming_enabled)
+        .function("isStreamingEnabled", &Mixer::streaming_enabled)
+        .function("getBackgroundQueueDepth", &Mixer::background_queue_depth)
+        .function("getBackgroundTaskStats", &Mixer::background_task_stats)
+        .function("getBufferDepth", &Mixer::buffer_depth)
+        .function("getBufferDepthReason", &Mixer::buffer_depth_reason)
         ;
     value_object<stem_info>("StemInfo")
         .field("id", &stem_info::id)
@@ -66,4 +105,16 @@ EMSCRIPTEN_BINDINGS(editor) {
         .field("tick", &song_position::tick)
         ;
     register_vector<tempo_tag>("VectorTempoTag");
+    value_object<task_class_stats>("TaskClassStats")
+        .field("name", &task_class_stats::name)
+        .field("queued", &task_class_stats::queued)
+        .field("running", &task_class_stats::running)
+        .field("completed", &task_class_stats::completed)
+        .field("cancelled", &task_class_stats::cancelled)
+        .field("coalesced", &task_class_stats::coalesced)
+        .field("averageWaitMs", &task_class_stats::average_wait_ms)
+        .field("averageRunMs", &task_class_stats::average_run_ms)
+        .field("maxRunMs", &task_class_stats::max_run_ms)
+        ;
+    register_vector<task_class_stats>("VectorTaskClassStats");
 }
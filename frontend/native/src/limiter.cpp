@@ -1,15 +1,219 @@
 #include <limiter.h>
 
 #include <audio-buffer.h>
-#include <utils.h>
+#include <mix-kernel.h>
 
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cfloat>
+#include <cmath>
 #include <limits>
+#include <vector>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 
 // TODO: implement ratio parameter
 
+namespace {
+
+const double DECIBELS_PER_LOG2 = 6.020599913279624; // 20 * log10(2)
+
+/*
+ * log2 of a positive float. The mantissa polynomial is a least squares
+ * fit on [1, 2), max absolute error 1.5e-5 (9e-5 dB).
+ */
+inline float fast_log2(float x)
+{
+    uint32_t bits = std::bit_cast<uint32_t>(x);
+    float exponent = static_cast<int>(bits >> 23) - 127;
+    float t = std::bit_cast<float>((bits & 0x007FFFFF) | 0x3F800000) - 1.f;
+
+    return exponent + (((((0.0439286277f * t - 0.189832446f) * t + 0.411561482f) * t
+        - 0.707253433f) * t + 1.44159208f) * t + 1.43909303e-05f);
+}
+
+/*
+ * 2^x for x in [-126, 128), clamped outside of it. The fraction polynomial
+ * is a least squares fit on [0, 1), max relative error 3.6e-6 (3.1e-5 dB).
+ */
+inline float fast_exp2(float x)
+{
+    x = std::clamp(x, -126.f, 127.f);
+
+    float whole = std::floor(x);
+    float t = x - whole;
+    float scale = std::bit_cast<float>(static_cast<uint32_t>(static_cast<int>(whole) + 127) << 23);
+
+    return scale * ((((0.0136839829f * t + 0.0517177355f) * t + 0.241621323f) * t
+        + 0.692969551f) * t + 1.0000036f);
+}
+
+// Inter-sample peaks are found by 4x interpolation with a short windowed
+// sinc, split into phases like in PeakMeter. Taps are stored per input
+// sample with the phases side by side, so all 4 phases are one SIMD vector.
+const int OVERSAMPLING = 4;
+const int INTERPOLATION_PHASE_TAPS = 8;
+// Input samples between the newest one and the interval the phases cover
+const int INTERPOLATION_DELAY = INTERPOLATION_PHASE_TAPS / 2;
+
+struct interpolation_taps {
+    alignas(16) std::array<std::array<float, OVERSAMPLING>, INTERPOLATION_PHASE_TAPS> taps;
+
+    interpolation_taps()
+    {
+        const int length = OVERSAMPLING * INTERPOLATION_PHASE_TAPS;
+        const double center = (length - 1) / 2.;
+
+        for (int p = 0; p < OVERSAMPLING; ++p) {
+            double sum = 0.;
+            for (int t = 0; t < INTERPOLATION_PHASE_TAPS; ++t) {
+                // Reversed, so every phase is a forward dot product over the history
+                int k = OVERSAMPLING * (INTERPOLATION_PHASE_TAPS - 1 - t) + p;
+                double x = (k - center) / OVERSAMPLING;
+                double sinc = std::sin(M_PI * x) / (M_PI * x);
+                double window = 0.5 - 0.5 * std::cos(2. * M_PI * (k + 0.5) / length);
+
+                taps[t][p] = sinc * window;
+                sum += taps[t][p];
+            }
+
+            // Unity gain at DC for every phase
+            for (auto& tap : taps) {
+                tap[p] /= sum;
+            }
+        }
+    }
+};
+
+const interpolation_taps INTERPOLATION_TAPS;
+
+/*
+ * True peak of the interval between the samples INTERPOLATION_DELAY and
+ * INTERPOLATION_DELAY - 1 before the last one in `window`
+ */
+inline float interpolated_peak(const float* window)
+{
+    float peak = std::abs(window[INTERPOLATION_PHASE_TAPS - 1 - INTERPOLATION_DELAY]);
+
+    const auto& taps = INTERPOLATION_TAPS.taps;
+
+#if defined(__wasm_simd128__)
+    v128_t values = wasm_f32x4_splat(0.f);
+    for (int t = 0; t < INTERPOLATION_PHASE_TAPS; ++t) {
+        values = wasm_f32x4_add(values,
+            wasm_f32x4_mul(wasm_v128_load(taps[t].data()), wasm_f32x4_splat(window[t])));
+    }
+
+    values = wasm_f32x4_abs(values);
+    peak = std::max({ peak, wasm_f32x4_extract_lane(values, 0), wasm_f32x4_extract_lane(values, 1),
+        wasm_f32x4_extract_lane(values, 2), wasm_f32x4_extract_lane(values, 3) });
+#elif defined(__SSE2__)
+    __m128 values = _mm_setzero_ps();
+    for (int t = 0; t < INTERPOLATION_PHASE_TAPS; ++t) {
+        values = _mm_add_ps(values, _mm_mul_ps(_mm_load_ps(taps[t].data()), _mm_set1_ps(window[t])));
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, _mm_andnot_ps(_mm_set1_ps(-0.f), values));
+    peak = std::max({ peak, lanes[0], lanes[1], lanes[2], lanes[3] });
+#else
+    for (int p = 0; p < OVERSAMPLING; ++p) {
+        float value = 0.f;
+        for (int t = 0; t < INTERPOLATION_PHASE_TAPS; ++t) {
+            value += taps[t][p] * window[t];
+        }
+
+        peak = std::max(peak, std::abs(value));
+    }
+#endif
+
+    return peak;
+}
+
+} // namespace
+
+/*
+ * Per channel state of the lookahead mode. Everything is sized for the
+ * longest lookahead up front, so the audio thread never allocates.
+ */
+struct Limiter::lookahead_state {
+    struct window_entry {
+        uint32_t index;
+        float required_gain;
+    };
+
+    // Input history for the peak interpolation
+    std::array<float, INTERPOLATION_PHASE_TAPS - 1 + AUDIO_CHUNK_SAMPLES> history;
+
+    // Monotonic deque (ring) of the gains required over the lookahead
+    // window, increasing from the front, so the front is the window minimum
+    std::vector<window_entry> window;
+    size_t window_front, window_size;
+
+    // Moving average of the window minimums, this ramps the gain down
+    std::vector<float> average_ring;
+    size_t average_position;
+    double average_sum;
+
+    std::vector<float> delay_line;
+    size_t delay_position;
+
+    uint32_t sample_index;
+
+    lookahead_state(size_t max_lookahead_samples)
+        : window(max_lookahead_samples + 2)
+        , average_ring(max_lookahead_samples)
+        , delay_line(max_lookahead_samples + INTERPOLATION_DELAY)
+    {
+        reset();
+    }
+
+    void reset()
+    {
+        history.fill(0.f);
+        window_front = 0;
+        window_size = 0;
+        std::fill(average_ring.begin(), average_ring.end(), 0.f);
+        average_position = 0;
+        average_sum = 0.;
+        std::fill(delay_line.begin(), delay_line.end(), 0.f);
+        delay_position = 0;
+        sample_index = 0;
+    }
+
+    float push_required_gain(float required_gain, uint32_t window_length)
+    {
+        // The entry leaving the window goes before the new one comes in,
+        // so the ring never holds more than `window_length` entries
+        while (window_size > 0 && sample_index - window[window_front].index >= window_length - 1) {
+            window_front = (window_front + 1) % window.size();
+            --window_size;
+        }
+
+        while (window_size > 0 && back().required_gain >= required_gain) {
+            --window_size;
+        }
+
+        window[(window_front + window_size++) % window.size()] = { sample_index, required_gain };
+
+        ++sample_index;
+        return window[window_front].required_gain;
+    }
+
+    const window_entry& back() const
+    {
+        return window[(window_front + window_size - 1) % window.size()];
+    }
+};
+
 const double Limiter::PEAK_DESCENT_RATE = 0.999;
+const double Limiter::LOOKAHEAD_MS_MAX = 20.;
 
 Limiter::Limiter()
     : _attack_ms(5.)
@@ -17,11 +221,61 @@ Limiter::Limiter()
     , _knee_db(0.)
     , _ratio(std::numeric_limits<double>::infinity())
     , _threshold_db(-1.)
+    , _mode(Mode::REACTIVE)
+    , _lookahead_ms(5.)
+    , _stereo_linked(false)
     , _current_peak_l(0.)
     , _current_peak_r(0.)
     , _current_reduction_l(0.)
     , _current_reduction_r(0.)
+    , _active_mode(Mode::REACTIVE)
+    , _active_stereo_linked(false)
+    , _active_lookahead_samples(lookahead_samples())
+{
+    size_t max_lookahead_samples = std::ceil(LOOKAHEAD_MS_MAX * AUDIO_SAMPLE_RATE / 1000.);
+    _lookahead_l = std::make_unique<lookahead_state>(max_lookahead_samples);
+    _lookahead_r = std::make_unique<lookahead_state>(max_lookahead_samples);
+}
+
+Limiter::~Limiter() = default;
+
+void Limiter::set_mode(Mode mode)
+{
+    _mode = mode;
+}
+
+Limiter::Mode Limiter::mode() const
+{
+    return _mode;
+}
+
+void Limiter::set_lookahead_ms(double lookahead_ms)
 {
+    _lookahead_ms = std::clamp(lookahead_ms, 0., LOOKAHEAD_MS_MAX);
+}
+
+double Limiter::lookahead_ms() const
+{
+    return _lookahead_ms;
+}
+
+void Limiter::set_stereo_linked(bool linked)
+{
+    _stereo_linked = linked;
+}
+
+bool Limiter::stereo_linked() const
+{
+    return _stereo_linked;
+}
+
+uint32_t Limiter::latency_samples() const
+{
+    if (_mode == Mode::REACTIVE) {
+        return 0;
+    }
+
+    return lookahead_samples() + INTERPOLATION_DELAY;
 }
 
 void Limiter::set_attack_ms(double attack_ms)
@@ -81,49 +335,170 @@ double Limiter::reduction_db() const
 
 void Limiter::apply(audio_chunk& chunk)
 {
+    // The envelope works in log2 units, 1 = 6.02 dB
     limiter_settings settings = {
         .attack = _attack_ms,
         .attack_coeff = milliseconds_to_ewma_coeff(_attack_ms),
         .release = _release_ms,
         .release_coeff = milliseconds_to_ewma_coeff(_release_ms),
-        .knee = _knee_db,
+        .knee = _knee_db / DECIBELS_PER_LOG2,
         .ratio = _ratio,
-        .threshold = _threshold_db,
+        .threshold = _threshold_db / DECIBELS_PER_LOG2,
     };
 
+    Mode mode = _mode;
+    bool stereo_linked = _stereo_linked;
+    uint32_t lookahead = lookahead_samples();
+    if (mode != _active_mode || stereo_linked != _active_stereo_linked
+        || lookahead != _active_lookahead_samples) {
+        _active_mode = mode;
+        _active_stereo_linked = stereo_linked;
+        _active_lookahead_samples = lookahead;
+        _lookahead_l->reset();
+        _lookahead_r->reset();
+        _current_reduction_l = 0.;
+        _current_reduction_r = 0.;
+    }
+
+    float* channels[] = { chunk.left_channel, chunk.right_channel };
+    lookahead_state* states[] = { _lookahead_l.get(), _lookahead_r.get() };
+
+    if (stereo_linked) {
+        // A single envelope, kept in the left channel state
+        if (mode == Mode::LOOKAHEAD) {
+            process_lookahead<2>(settings, channels, states, _current_reduction_l);
+        } else {
+            process_reactive<2>(settings, channels, _current_peak_l, _current_reduction_l);
+        }
+
+        _current_reduction_r = _current_reduction_l;
+    } else if (mode == Mode::LOOKAHEAD) {
+        process_lookahead<1>(settings, &channels[0], &states[0], _current_reduction_l);
+        process_lookahead<1>(settings, &channels[1], &states[1], _current_reduction_r);
+    } else {
+        process_reactive<1>(settings, &channels[0], _current_peak_l, _current_reduction_l);
+        process_reactive<1>(settings, &channels[1], _current_peak_r, _current_reduction_r);
+    }
+
+    _reduction_db = std::min(_current_reduction_l, _current_reduction_r) * DECIBELS_PER_LOG2;
+}
+
+uint32_t Limiter::lookahead_samples() const
+{
+    return std::max<uint32_t>(1, std::lround(_lookahead_ms * AUDIO_SAMPLE_RATE / 1000.));
+}
+
+template <int channel_count>
+void Limiter::process_lookahead(const limiter_settings& settings, float* const* channels,
+    lookahead_state* const* states, double& reduction)
+{
+    std::array<float, AUDIO_CHUNK_SAMPLES> gains;
+    uint32_t lookahead = _active_lookahead_samples;
+    lookahead_state& envelope = *states[0];
+
+    for (int c = 0; c < channel_count; ++c) {
+        auto& history = states[c]->history;
+        std::copy(history.end() - (INTERPOLATION_PHASE_TAPS - 1), history.end(), history.begin());
+        std::copy(channels[c], channels[c] + AUDIO_CHUNK_SAMPLES,
+            history.begin() + INTERPOLATION_PHASE_TAPS - 1);
+    }
+
     for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
-        process_sample(settings, chunk.left_channel[i], _current_peak_l, _current_reduction_l);
-        process_sample(settings, chunk.right_channel[i], _current_peak_r, _current_reduction_r);
+        float peak = 0.f;
+        for (int c = 0; c < channel_count; ++c) {
+            peak = std::max(peak, interpolated_peak(&states[c]->history[i]));
+        }
+
+        float peak_log2 = fast_log2(std::max(peak, FLT_MIN));
+        float required_gain = calculate_target(settings, peak_log2) - peak_log2;
+
+        // Every gain in the moving average is at most the one required by
+        // any peak in its window, so by the time a peak leaves the delay
+        // line the gain is fully down. The window is one sample wider on
+        // each side as the interpolated peaks lie between two samples.
+        float window_gain = envelope.push_required_gain(required_gain, lookahead + 2);
+
+        envelope.average_sum += window_gain - envelope.average_ring[envelope.average_position];
+        envelope.average_ring[envelope.average_position] = window_gain;
+        envelope.average_position = (envelope.average_position + 1) % lookahead;
+        double target_gain = envelope.average_sum / lookahead;
+
+        if (target_gain < reduction) {
+            reduction = target_gain;
+        } else {
+            reduction += settings.release_coeff * (target_gain - reduction);
+        }
+
+        gains[i] = reduction;
+
+        for (int c = 0; c < channel_count; ++c) {
+            lookahead_state& state = *states[c];
+            float delayed_sample = state.delay_line[state.delay_position];
+            state.delay_line[state.delay_position] = channels[c][i];
+            state.delay_position = (state.delay_position + 1) % (lookahead + INTERPOLATION_DELAY);
+            channels[c][i] = delayed_sample;
+        }
+    }
+
+    for (auto& gain : gains) {
+        gain = fast_exp2(gain);
     }
 
-    _reduction_db = std::min(_current_reduction_l, _current_reduction_r);
+    for (int c = 0; c < channel_count; ++c) {
+        MixKernel::apply_gain(channels[c], gains.data(), AUDIO_CHUNK_SAMPLES);
+    }
 }
 
-void Limiter::process_sample(const limiter_settings& settings, 
-    float& sample, double& peak, double& reduction)
+template <int channel_count>
+void Limiter::process_reactive(const limiter_settings& settings, float* const* channels,
+    double& peak, double& reduction)
 {
-    peak *= PEAK_DESCENT_RATE;
-    peak = std::max<double>({ peak, std::abs(sample) });
+    std::array<float, AUDIO_CHUNK_SAMPLES> gains;
+
+    // The envelope is the only sequential part, it stays in log2 units
+    // for the whole block
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+        float sample_peak = 0.f;
+        for (int c = 0; c < channel_count; ++c) {
+            sample_peak = std::max(sample_peak, std::abs(channels[c][i]));
+        }
+
+        peak *= PEAK_DESCENT_RATE;
+        peak = std::max<double>(peak, sample_peak);
 
-    double peak_db = Utils::gain_to_decibels(peak);
-    double target_db = calculate_target_db(settings, peak_db);
-    double target_gain_db = target_db - peak_db;
+        double peak_log2 = fast_log2(std::max<float>(peak, FLT_MIN));
+        double target_gain = calculate_target(settings, peak_log2) - peak_log2;
 
-    if (reduction < target_gain_db) {
-        reduction += settings.release_coeff * (target_gain_db - reduction);
-    } else if (reduction > target_gain_db) {
-        reduction += settings.attack_coeff * (target_gain_db - reduction);
+        if (reduction < target_gain) {
+            reduction += settings.release_coeff * (target_gain - reduction);
+        } else if (reduction > target_gain) {
+            reduction += settings.attack_coeff * (target_gain - reduction);
+        }
+
+        gains[i] = reduction;
+    }
+
+    for (auto& gain : gains) {
+        gain = fast_exp2(gain);
     }
 
-    double sample_gain = Utils::decibels_to_gain(reduction);
-    sample *= sample_gain;
+    // Transients overshoot until the attack catches up, those are
+    // hard clipped at full scale
+    for (int c = 0; c < channel_count; ++c) {
+        MixKernel::apply_gain(channels[c], gains.data(), AUDIO_CHUNK_SAMPLES);
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            channels[c][i] = std::clamp(channels[c][i], -1.f, 1.f);
+        }
+    }
 }
 
-double Limiter::calculate_target_db(const limiter_settings& settings, double input_db)
+double Limiter::calculate_target(const limiter_settings& settings, double input)
 {
-    if (input_db < settings.threshold - settings.knee / 2.) return input_db;
-    if (input_db > settings.threshold + settings.knee / 2.) return settings.threshold;
-    return input_db - std::pow(input_db - settings.threshold + settings.knee / 2., 2.) / (2. * settings.knee);
+    if (input < settings.threshold - settings.knee / 2.) return input;
+    if (input >= settings.threshold + settings.knee / 2.) return settings.threshold;
+
+    double knee_input = input - settings.threshold + settings.knee / 2.;
+    return input - knee_input * knee_input / (2. * settings.knee);
 }
 
 double Limiter::milliseconds_to_ewma_coeff(double time_ms) const
@@ -131,4 +506,3 @@ double Limiter::milliseconds_to_ewma_coeff(double time_ms) const
     if (time_ms < 0.001) return 0;
     return 1 - std::exp(-2. * M_PI * 100.0 / AUDIO_SAMPLE_RATE / time_ms);
 }
-
@@ -7,7 +7,10 @@
 #include <iostream>
 #include <memory>
 
-#define AUDIO_BUFFER_SIZE 2048
+// The buffer depth adapts to underflows at runtime, starting low
+// for interactive latency and never exceeding the capacity
+#define AUDIO_BUFFER_CAPACITY 4096
+#define AUDIO_BUFFER_INITIAL_DEPTH 256
 
 std::unique_ptr<AudioWorklet> g_worklet;
 std::unique_ptr<Mixer> g_mixer;
@@ -17,7 +20,8 @@ int main() {
     std::cout << "WASM module is initializing..." << std::endl;
 
     // Create audio buffer
-    std::shared_ptr<AudioBuffer> buffer = std::make_unique<AudioBuffer>(AUDIO_BUFFER_SIZE);
+    std::shared_ptr<AudioBuffer> buffer = std::make_unique<AudioBuffer>(AUDIO_BUFFER_CAPACITY);
+    buffer->set_depth(AUDIO_BUFFER_INITIAL_DEPTH);
 
     // Create audio worklet
     g_worklet = std::make_unique<AudioWorklet>();
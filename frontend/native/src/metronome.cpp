@@ -1,18 +1,43 @@
 #include <metronome.h>
 
 #include <audio-buffer.h>
+#include <mix-kernel.h>
 #include <tempo.h>
 
+#include <algorithm>
+#include <array>
 
+
+// Ticks start this many samples ahead of their beat
 const int Metronome::TICK_OFFSET = 128;
+const int Metronome::MAX_BEATS_PER_CHUNK = 4;
+
+namespace {
+
+std::vector<float> convert_sound(const uint8_t* data, int samples)
+{
+    const int16_t* source = reinterpret_cast<const int16_t*>(data);
+
+    std::vector<float> sound(samples);
+    for (int i = 0; i < samples; ++i) {
+        sound[i] = source[i] / 32768.f;
+    }
+
+    return sound;
+}
+
+} // namespace
 
 Metronome::Metronome(const Tempo& tempo)
     : _tempo(tempo)
     , _gain(1.0)
-    , _current_sample(reinterpret_cast<const int16_t*>(SOUND_BAR))
-    , _current_sample_length(SOUND_BAR_SAMPLES)
-    , _sample_position(SOUND_BAR_SAMPLES)
+    , _scheduled_ticks(MAX_BEATS_PER_CHUNK)
+    , _scheduled_tick_count(0)
+    , _current_bar_start(true)
 {
+    set_sound(true, {});
+    set_sound(false, {});
+    _sample_position = _sound_bar.size();
 }
 
 void Metronome::set_gain(double new_gain)
@@ -25,43 +50,71 @@ double Metronome::gain() const
     return _gain;
 }
 
+void Metronome::set_sound(bool bar_start, std::vector<float> samples)
+{
+    if (samples.empty()) {
+        samples = bar_start
+            ? convert_sound(SOUND_BAR, SOUND_BAR_SAMPLES)
+            : convert_sound(SOUND_BEAT, SOUND_BEAT_SAMPLES);
+    }
+
+    (bar_start ? _sound_bar : _sound_beat) = std::move(samples);
+}
+
 void Metronome::process(uint32_t first_sample)
 {
-    auto old_position = _tempo.current_position(first_sample + TICK_OFFSET - 1);
-
-    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
-        uint32_t sample = first_sample + i + TICK_OFFSET;
-        auto new_position = _tempo.current_position(sample);
-        new_position.tick = old_position.tick;
-
-        if (old_position != new_position || sample == TICK_OFFSET) {
-            // Metronome should tick right now
-
-            if (new_position.step == 1) {
-                // Bar tick
-                _current_sample = reinterpret_cast<const int16_t*>(SOUND_BAR);
-                _current_sample_length = SOUND_BAR_SAMPLES;
-            } else {
-                // Beat tick
-                _current_sample = reinterpret_cast<const int16_t*>(SOUND_BEAT);
-                _current_sample_length = SOUND_BEAT_SAMPLES;
-            }
-
-            _sample_position = 0;
+    // Ticks are looked up TICK_OFFSET samples ahead, except at the very
+    // start, where the first beats can't be ahead of the playhead and
+    // start right away
+    std::array<beat_event, MAX_BEATS_PER_CHUNK> beats;
+    uint32_t window_start = first_sample == 0 ? 0 : first_sample + TICK_OFFSET;
+    size_t beat_count = _tempo.beats_in_range(window_start,
+        first_sample + TICK_OFFSET + AUDIO_CHUNK_SAMPLES, beats.data(), beats.size());
+
+    _scheduled_tick_count = 0;
+    for (size_t i = 0; i < beat_count; ++i) {
+        int offset = std::max<int64_t>(0, int64_t(beats[i].sample) - TICK_OFFSET - first_sample);
+
+        // A later tick at the same offset replaces the earlier one
+        if (_scheduled_tick_count > 0 && _scheduled_ticks[_scheduled_tick_count - 1].offset == offset) {
+            --_scheduled_tick_count;
         }
 
-        old_position = new_position;
+        _scheduled_ticks[_scheduled_tick_count++] = { offset, beats[i].bar_start };
     }
 }
 
 void Metronome::render(audio_chunk& chunk)
 {
-    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
-        if (_sample_position < _current_sample_length) {
-            float sample_value = _current_sample[_sample_position++] / 32768.0 * _gain;
-            chunk.left_channel[i] += sample_value;
-            chunk.right_channel[i] += sample_value;
-        }
+    // The current tick plays until the next scheduled one starts
+    int position = 0;
+    for (size_t i = 0; i < _scheduled_tick_count; ++i) {
+        const auto& tick = _scheduled_ticks[i];
+        mix_tick(chunk, position, tick.offset);
+
+        _current_bar_start = tick.bar_start;
+        _sample_position = 0;
+        position = tick.offset;
     }
+
+    mix_tick(chunk, position, AUDIO_CHUNK_SAMPLES);
+    _scheduled_tick_count = 0;
 }
 
+const std::vector<float>& Metronome::sound(bool bar_start) const
+{
+    return bar_start ? _sound_bar : _sound_beat;
+}
+
+void Metronome::mix_tick(audio_chunk& chunk, int start, int end)
+{
+    const auto& samples = sound(_current_bar_start);
+    if (_sample_position >= samples.size()) {
+        return;
+    }
+
+    int count = std::min<size_t>(end - start, samples.size() - _sample_position);
+    MixKernel::mix_mono(&samples[_sample_position], count, _gain,
+        chunk.left_channel + start, chunk.right_channel + start);
+    _sample_position += count;
+}
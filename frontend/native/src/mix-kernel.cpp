@@ -0,0 +1,126 @@
+#include <mix-kernel.h>
+
+#if defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+
+void MixKernel::mix_stereo(const int16_t* source, int frames,
+    float gain_l, float gain_r, float* left, float* right)
+{
+    int frame = 0;
+
+#if defined(__wasm_simd128__)
+    const v128_t vgain_l = wasm_f32x4_splat(gain_l);
+    const v128_t vgain_r = wasm_f32x4_splat(gain_r);
+
+    // 4 stereo frames (8 samples) per iteration
+    for (; frame + 4 <= frames; frame += 4) {
+        v128_t interleaved = wasm_v128_load(source + 2 * frame);
+
+        // Each 32-bit lane holds one frame, R in the upper half. Arithmetic
+        // shifts sign-extend both channels without any shuffles.
+        v128_t samples_l = wasm_f32x4_convert_i32x4(
+            wasm_i32x4_shr(wasm_i32x4_shl(interleaved, 16), 16));
+        v128_t samples_r = wasm_f32x4_convert_i32x4(wasm_i32x4_shr(interleaved, 16));
+
+        v128_t out_l = wasm_v128_load(left + frame);
+        v128_t out_r = wasm_v128_load(right + frame);
+        wasm_v128_store(left + frame, wasm_f32x4_add(out_l, wasm_f32x4_mul(samples_l, vgain_l)));
+        wasm_v128_store(right + frame, wasm_f32x4_add(out_r, wasm_f32x4_mul(samples_r, vgain_r)));
+    }
+#elif defined(__SSE2__)
+    const __m128 vgain_l = _mm_set1_ps(gain_l);
+    const __m128 vgain_r = _mm_set1_ps(gain_r);
+
+    // 4 stereo frames (8 samples) per iteration
+    for (; frame + 4 <= frames; frame += 4) {
+        __m128i interleaved = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + 2 * frame));
+
+        // Each 32-bit lane holds one frame, R in the upper half. Arithmetic
+        // shifts sign-extend both channels without any shuffles.
+        __m128 samples_l = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(interleaved, 16), 16));
+        __m128 samples_r = _mm_cvtepi32_ps(_mm_srai_epi32(interleaved, 16));
+
+        __m128 out_l = _mm_loadu_ps(left + frame);
+        __m128 out_r = _mm_loadu_ps(right + frame);
+        _mm_storeu_ps(left + frame, _mm_add_ps(out_l, _mm_mul_ps(samples_l, vgain_l)));
+        _mm_storeu_ps(right + frame, _mm_add_ps(out_r, _mm_mul_ps(samples_r, vgain_r)));
+    }
+#endif
+
+    // Remainder (or everything if there's no SIMD support)
+    mix_stereo_scalar(source + 2 * frame, frames - frame, gain_l, gain_r, left + frame, right + frame);
+}
+
+void MixKernel::mix_stereo_scalar(const int16_t* source, int frames,
+    float gain_l, float gain_r, float* left, float* right)
+{
+    for (int i = 0; i < frames; ++i) {
+        left[i] += source[2 * i] * gain_l;
+        right[i] += source[2 * i + 1] * gain_r;
+    }
+}
+
+void MixKernel::mix_mono(const float* source, int count, float gain, float* left, float* right)
+{
+    int i = 0;
+
+#if defined(__wasm_simd128__)
+    const v128_t vgain = wasm_f32x4_splat(gain);
+
+    for (; i + 4 <= count; i += 4) {
+        v128_t samples = wasm_f32x4_mul(wasm_v128_load(source + i), vgain);
+        wasm_v128_store(left + i, wasm_f32x4_add(wasm_v128_load(left + i), samples));
+        wasm_v128_store(right + i, wasm_f32x4_add(wasm_v128_load(right + i), samples));
+    }
+#elif defined(__SSE2__)
+    const __m128 vgain = _mm_set1_ps(gain);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 samples = _mm_mul_ps(_mm_loadu_ps(source + i), vgain);
+        _mm_storeu_ps(left + i, _mm_add_ps(_mm_loadu_ps(left + i), samples));
+        _mm_storeu_ps(right + i, _mm_add_ps(_mm_loadu_ps(right + i), samples));
+    }
+#endif
+
+    // Remainder (or everything if there's no SIMD support)
+    mix_mono_scalar(source + i, count - i, gain, left + i, right + i);
+}
+
+void MixKernel::mix_mono_scalar(const float* source, int count, float gain,
+    float* left, float* right)
+{
+    for (int i = 0; i < count; ++i) {
+        left[i] += source[i] * gain;
+        right[i] += source[i] * gain;
+    }
+}
+
+void MixKernel::apply_gain(float* samples, const float* gains, int count)
+{
+    int i = 0;
+
+#if defined(__wasm_simd128__)
+    for (; i + 4 <= count; i += 4) {
+        wasm_v128_store(samples + i,
+            wasm_f32x4_mul(wasm_v128_load(samples + i), wasm_v128_load(gains + i)));
+    }
+#elif defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(samples + i, _mm_mul_ps(_mm_loadu_ps(samples + i), _mm_loadu_ps(gains + i)));
+    }
+#endif
+
+    // Remainder (or everything if there's no SIMD support)
+    apply_gain_scalar(samples + i, gains + i, count - i);
+}
+
+void MixKernel::apply_gain_scalar(float* samples, const float* gains, int count)
+{
+    for (int i = 0; i < count; ++i) {
+        samples[i] *= gains[i];
+    }
+}
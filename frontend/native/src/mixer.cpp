@@ -8,10 +8,19 @@
 
 #include <emscripten.h>
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 #include <iostream>
 
-#define UNDERFLOW_COUNTDOWN_INITIAL_VALUE 1000
+// Underflows are checked every ~0.3 s
+#define UNDERFLOW_CHECK_INTERVAL 100
+// The buffer is shrunk after ~30 s without underflows. Every growth doubles
+// this period (up to the maximum) so that an unstable machine doesn't keep
+// bouncing between two depths.
+#define BUFFER_STABLE_CHECKS_INITIAL 100
+#define BUFFER_STABLE_CHECKS_MAX 1600
+#define BUFFER_DEPTH_MIN_SAMPLES 256
 
 Mixer::Mixer(std::shared_ptr<AudioBuffer> out_buffer)
     : _buffer(std::move(out_buffer))
@@ -26,6 +35,7 @@ Mixer::Mixer(std::shared_ptr<AudioBuffer> out_buffer)
     , _metronome_enabled(false)
     , _metronome_gain_db(1.0)
     , _limiter(std::make_unique<Limiter>())
+    , _buffer_depth_reason("Initial depth")
 {
     _stems.set_bg_task_complete_callback(
         std::bind(&Mixer::invalidate_state, this));
@@ -36,6 +46,9 @@ Mixer::Mixer(std::shared_ptr<AudioBuffer> out_buffer)
     _limiter->set_threshold_db(-2);
     _limiter->set_attack_ms(5.);
     _limiter->set_release_ms(50.);
+    _limiter->set_lookahead_ms(5.);
+    _limiter->set_mode(Limiter::Mode::LOOKAHEAD);
+    _limiter->set_stereo_linked(true);
 }
 
 Mixer::~Mixer()
@@ -149,6 +162,16 @@ double Mixer::metronome_gain_db() const
     return _metronome_gain_db;
 }
 
+void Mixer::set_metronome_sound(bool bar_start, std::vector<float> samples)
+{
+    {
+        std::lock_guard lock(_mixdown_lock);
+        _metronome->set_sound(bar_start, std::move(samples));
+    }
+
+    invalidate_state();
+}
+
 void Mixer::set_track_bpm(double bpm, uint32_t time_sig_numerator)
 {
     _tempo->set_stable_bpm(bpm, time_sig_numerator);
@@ -215,6 +238,21 @@ std::string Mixer::waveform_data_uri(uint32_t stem_id) const
     return _stems.waveform_data_uri(stem_id);
 }
 
+std::shared_ptr<const std::vector<uint8_t>> Mixer::pin_waveform_image(uint32_t stem_id)
+{
+    return _stems.pin_waveform_image(stem_id);
+}
+
+int Mixer::waveform_width() const
+{
+    return _stems.waveform_width();
+}
+
+int Mixer::waveform_height() const
+{
+    return _stems.waveform_height();
+}
+
 void Mixer::toggle_mute(uint32_t stem_id)
 {
     _stems.toggle_mute(stem_id);
@@ -248,41 +286,165 @@ double Mixer::limiter_reduction_db() const
     return _limiter->reduction_db();
 }
 
+void Mixer::set_limiter_lookahead_enabled(bool enabled)
+{
+    _limiter->set_mode(enabled ? Limiter::Mode::LOOKAHEAD : Limiter::Mode::REACTIVE);
+}
+
+bool Mixer::limiter_lookahead_enabled() const
+{
+    return _limiter->mode() == Limiter::Mode::LOOKAHEAD;
+}
+
+void Mixer::set_limiter_stereo_linked(bool linked)
+{
+    _limiter->set_stereo_linked(linked);
+}
+
+bool Mixer::limiter_stereo_linked() const
+{
+    return _limiter->stereo_linked();
+}
+
+uint32_t Mixer::limiter_latency_samples() const
+{
+    return _limiter->latency_samples();
+}
+
+void Mixer::set_mix_thread_count(uint32_t count)
+{
+    _stems.set_mix_thread_count(count);
+    invalidate_state();
+}
+
+uint32_t Mixer::mix_thread_count() const
+{
+    return _stems.mix_thread_count();
+}
+
+uint32_t Mixer::max_mix_thread_count() const
+{
+    return _stems.max_mix_thread_count();
+}
+
+void Mixer::set_streaming_enabled(bool enabled)
+{
+    _stems.set_streaming_enabled(enabled);
+    invalidate_state();
+}
+
+bool Mixer::streaming_enabled() const
+{
+    return _stems.streaming_enabled();
+}
+
+size_t Mixer::background_queue_depth() const
+{
+    return _stems.background_queue_depth();
+}
+
+std::vector<task_class_stats> Mixer::background_task_stats() const
+{
+    return _stems.background_task_stats();
+}
+
+uint32_t Mixer::buffer_depth() const
+{
+    return _buffer->depth();
+}
+
+std::string Mixer::buffer_depth_reason() const
+{
+    std::lock_guard lock(_buffer_depth_mutex);
+    return _buffer_depth_reason;
+}
+
 void Mixer::thread_main()
 {
     int last_underflows = _buffer->underflow_count();
-    int undeflow_check_countdown = UNDERFLOW_COUNTDOWN_INITIAL_VALUE;
+    int underflow_check_countdown = UNDERFLOW_CHECK_INTERVAL;
+    int stable_checks = 0;
+    int stable_checks_required = BUFFER_STABLE_CHECKS_INITIAL;
 
     std::cout << "[MIXER] Audio processing thread started" << std::endl;
 
     while (true) {
-        audio_chunk chunk;
-        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
-            chunk.left_channel[i] = 0;
-            chunk.right_channel[i] = 0;
-        }
+        // Render straight into the ring buffer storage
+        audio_chunk& chunk = _buffer->acquire_write_slot();
+        memset(&chunk, 0, sizeof(audio_chunk));
 
         perform_mixdown(chunk);
 
-        (*_buffer) << chunk;
+        _buffer->commit_write_slot();
 
         if (_playback_position > _length) {
             stop();
         }
 
-        if (--undeflow_check_countdown == 0) {
-            int current_undeflows = _buffer->underflow_count();
-            if (current_undeflows > last_underflows) {
-                int underflow_delta = current_undeflows - last_underflows;
+        if (--underflow_check_countdown == 0) {
+            underflow_check_countdown = UNDERFLOW_CHECK_INTERVAL;
+
+            int current_underflows = _buffer->underflow_count();
+            int underflow_delta = current_underflows - last_underflows;
+            last_underflows = current_underflows;
+
+            if (underflow_delta > 0) {
                 std::cerr << "[MIXER] Can't keep up! "
                           << "Buffer underflowed " << underflow_delta << " time(s)" << std::endl;
-                last_underflows = current_undeflows;
-                undeflow_check_countdown = UNDERFLOW_COUNTDOWN_INITIAL_VALUE;
+
+                grow_buffer_depth(underflow_delta);
+                stable_checks = 0;
+                stable_checks_required = std::min(
+                    2 * stable_checks_required, BUFFER_STABLE_CHECKS_MAX);
+            } else if (++stable_checks >= stable_checks_required) {
+                shrink_buffer_depth(stable_checks);
+                stable_checks = 0;
             }
         }
     }
 }
 
+void Mixer::grow_buffer_depth(int underflows)
+{
+    int old_depth = _buffer->depth();
+    int new_depth = std::min(2 * old_depth, _buffer->capacity());
+    if (new_depth == old_depth) {
+        return;
+    }
+
+    _buffer->set_depth(new_depth);
+    set_buffer_depth_reason("Grown from " + std::to_string(old_depth) + " to "
+        + std::to_string(new_depth) + " samples after " + std::to_string(underflows)
+        + " underflow(s)");
+}
+
+void Mixer::shrink_buffer_depth(int stable_checks)
+{
+    int old_depth = _buffer->depth();
+    int new_depth = std::max(old_depth / 2, BUFFER_DEPTH_MIN_SAMPLES);
+    if (new_depth == old_depth) {
+        return;
+    }
+
+    // Straight to seconds, going through milliseconds overflowed an int
+    // for the longest stable periods
+    int stable_seconds = stable_checks * UNDERFLOW_CHECK_INTERVAL
+        * AUDIO_CHUNK_SAMPLES / AUDIO_SAMPLE_RATE;
+
+    _buffer->set_depth(new_depth);
+    set_buffer_depth_reason("Shrunk from " + std::to_string(old_depth) + " to "
+        + std::to_string(new_depth) + " samples after " + std::to_string(stable_seconds)
+        + " s without underflows");
+}
+
+void Mixer::set_buffer_depth_reason(std::string reason)
+{
+    std::cout << "[MIXER] " << reason << std::endl;
+
+    std::lock_guard lock(_buffer_depth_mutex);
+    _buffer_depth_reason = std::move(reason);
+}
+
 void Mixer::perform_mixdown(audio_chunk& chunk)
 {
     std::lock_guard lock(_mixdown_lock);
@@ -4,8 +4,10 @@
 #include <filter-fir.h>
 #include <utils.h>
 
+#include <algorithm>
 #include <array>
 #include <cstdlib>
+#include <vector>
 
 // LPF taps definition (Hamming window, sample rate 176400 Hz, cutoff 22050 Hz)
 std::array RESAMPLER_TAPS = {
@@ -124,38 +126,71 @@ std::array RESAMPLER_TAPS = {
 
 const double PeakMeter::DESCENT_RATE = 0.99991;
 
+// Zero-stuffed 4x upsampling through RESAMPLER_TAPS is equivalent to
+// running every input sample through 4 interleaved subfilters (phases)
+const int OVERSAMPLING = 4;
+const int PHASE_TAPS = (RESAMPLER_TAPS.size() + OVERSAMPLING - 1) / OVERSAMPLING;
+
 class PeakMeter::impl {
 private:
-    using FilterType = FIRFilter<RESAMPLER_TAPS.size()>;
+    using PhaseFilter = FIRFilter<PHASE_TAPS>;
+
+    /*
+     * Phase `p` output of input sample `n` is the sum of
+     * RESAMPLER_TAPS[OVERSAMPLING * j + p] * x[n - j], padded with zeros
+     * up to a whole number of phases
+     */
+    static std::vector<PhaseFilter> make_phase_filters()
+    {
+        std::vector<PhaseFilter> filters;
+        for (int p = 0; p < OVERSAMPLING; ++p) {
+            std::array<float, PHASE_TAPS> coefficients;
+            for (int j = 0; j < PHASE_TAPS; ++j) {
+                size_t tap = OVERSAMPLING * j + p;
+                coefficients[j] = tap < RESAMPLER_TAPS.size() ? RESAMPLER_TAPS[tap] : 0.f;
+            }
+
+            filters.emplace_back(coefficients);
+        }
+
+        return filters;
+    }
+
+    using PhaseSamples = std::array<std::array<float, AUDIO_CHUNK_SAMPLES>, OVERSAMPLING>;
+
     PeakMeter* _instance;
-    FilterType _left_lpf;
-    FilterType _right_lpf;
+    std::vector<PhaseFilter> _left_phases;
+    std::vector<PhaseFilter> _right_phases;
+    PhaseSamples _phase_samples;
     double _left_peak, _right_peak;
 
-    void process_sample(float sample, FilterType& filter, double& peak)
+    void process_channel(const float* samples, std::vector<PhaseFilter>& phases, double& peak)
     {
         // Based on ITU.R BS.1770-4 Annex 2
         // Omitting -12.04 dB attenuation - floating point arithmetic is used
 
-        peak *= PeakMeter::DESCENT_RATE;
-        float this_peak = std::abs(sample);
-        
-        // Oversample 4x and put into LPF
-        this_peak = std::max(this_peak, std::abs(filter(sample)));
-        this_peak = std::max(this_peak, std::abs(filter(0.f)));
-        this_peak = std::max(this_peak, std::abs(filter(0.f)));
-        this_peak = std::max(this_peak, std::abs(filter(0.f)));
-
-        if (this_peak > peak) {
-            peak = this_peak;
+        for (int p = 0; p < OVERSAMPLING; ++p) {
+            phases[p].process(samples, _phase_samples[p].data(), AUDIO_CHUNK_SAMPLES);
+        }
+
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            float this_peak = std::abs(samples[i]);
+            for (const auto& phase : _phase_samples) {
+                this_peak = std::max(this_peak, std::abs(phase[i]));
+            }
+
+            peak *= PeakMeter::DESCENT_RATE;
+            if (this_peak > peak) {
+                peak = this_peak;
+            }
         }
     }
 
 public:
     impl(PeakMeter* instance)
         : _instance(instance)
-        , _left_lpf(RESAMPLER_TAPS)
-        , _right_lpf(RESAMPLER_TAPS)
+        , _left_phases(make_phase_filters())
+        , _right_phases(make_phase_filters())
         , _left_peak(0.0)
         , _right_peak(0.0)
     {
@@ -173,10 +208,8 @@ public:
 
     void process(const audio_chunk& chunk)
     {
-        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
-            process_sample(chunk.left_channel[i], _left_lpf, _left_peak);
-            process_sample(chunk.right_channel[i], _right_lpf, _right_peak);
-        }
+        process_channel(chunk.left_channel, _left_phases, _left_peak);
+        process_channel(chunk.right_channel, _right_phases, _right_peak);
     }
 
     void reset()
@@ -0,0 +1,104 @@
+#include <peak-pyramid.h>
+
+#include <algorithm>
+#include <climits>
+
+
+PeakPyramid::PeakPyramid()
+    : _num_samples(0)
+{
+}
+
+void PeakPyramid::build(const int16_t* samples, uint32_t num_samples)
+{
+    _num_samples = num_samples;
+    _levels.clear();
+
+    if (num_samples == 0) {
+        return;
+    }
+
+    // The only full pass over the samples
+    auto& base = _levels.emplace_back((num_samples + BASE_BLOCK_SAMPLES - 1) / BASE_BLOCK_SAMPLES);
+    for (size_t block = 0; block < base.size(); ++block) {
+        uint32_t first_sample = block * BASE_BLOCK_SAMPLES;
+        uint32_t last_sample = std::min(first_sample + BASE_BLOCK_SAMPLES, num_samples);
+
+        int16_t high = INT16_MIN, low = INT16_MAX;
+        for (uint32_t i = 2 * first_sample; i < 2 * last_sample; ++i) {
+            high = std::max(high, samples[i]);
+            low = std::min(low, samples[i]);
+        }
+
+        base[block] = { high, low };
+    }
+
+    while (_levels.back().size() > 1) {
+        const auto& lower = _levels.back();
+        std::vector<block_peaks> upper((lower.size() + 1) / 2);
+
+        for (size_t block = 0; block < upper.size(); ++block) {
+            upper[block] = lower[2 * block];
+            if (2 * block + 1 < lower.size()) {
+                upper[block].high = std::max(upper[block].high, lower[2 * block + 1].high);
+                upper[block].low = std::min(upper[block].low, lower[2 * block + 1].low);
+            }
+        }
+
+        _levels.push_back(std::move(upper));
+    }
+}
+
+bool PeakPyramid::empty() const
+{
+    return _levels.empty();
+}
+
+size_t PeakPyramid::memory_usage() const
+{
+    size_t usage = 0;
+    for (const auto& level : _levels) {
+        usage += level.size() * sizeof(block_peaks);
+    }
+
+    return usage;
+}
+
+std::pair<int16_t, int16_t> PeakPyramid::peaks(int64_t first_sample, int64_t last_sample) const
+{
+    int16_t high = INT16_MIN, low = INT16_MAX;
+
+    first_sample = std::max<int64_t>(first_sample, 0);
+    last_sample = std::min<int64_t>(last_sample, _num_samples);
+    if (first_sample >= last_sample) {
+        return std::make_pair(high, low);
+    }
+
+    size_t first_block = first_sample / BASE_BLOCK_SAMPLES;
+    size_t last_block = (last_sample + BASE_BLOCK_SAMPLES - 1) / BASE_BLOCK_SAMPLES;
+
+    // Bottom-up: take the unpaired blocks at both ends of the range,
+    // then continue with the remaining pairs one level higher
+    for (const auto& level : _levels) {
+        if (first_block >= last_block) {
+            break;
+        }
+
+        if (first_block & 1) {
+            high = std::max(high, level[first_block].high);
+            low = std::min(low, level[first_block].low);
+            ++first_block;
+        }
+
+        if (last_block & 1) {
+            --last_block;
+            high = std::max(high, level[last_block].high);
+            low = std::min(low, level[last_block].low);
+        }
+
+        first_block /= 2;
+        last_block /= 2;
+    }
+
+    return std::make_pair(high, low);
+}
@@ -0,0 +1,350 @@
+#include <png-encoder.h>
+
+#include <lodepng.h>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+
+const size_t PngEncoder::PALETTE_SIZE_MAX = 256;
+
+namespace {
+
+// Writes Deflate bit fields, least significant bit first
+class BitWriter {
+public:
+    BitWriter(std::vector<uint8_t>& out)
+        : _out(out)
+        , _buffer(0)
+        , _bits(0)
+    {
+    }
+
+    void write(uint32_t value, int bits)
+    {
+        _buffer |= static_cast<uint64_t>(value) << _bits;
+        _bits += bits;
+
+        while (_bits >= 8) {
+            _out.push_back(_buffer & 0xFF);
+            _buffer >>= 8;
+            _bits -= 8;
+        }
+    }
+
+    // Huffman codes are stored most significant bit first
+    void write_code(uint32_t code, int bits)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < bits; ++i) {
+            reversed = (reversed << 1) | ((code >> i) & 1);
+        }
+
+        write(reversed, bits);
+    }
+
+    void flush()
+    {
+        if (_bits > 0) {
+            _out.push_back(_buffer & 0xFF);
+        }
+
+        _buffer = 0;
+        _bits = 0;
+    }
+
+private:
+    std::vector<uint8_t>& _out;
+    uint64_t _buffer;
+    int _bits;
+};
+
+const int MATCH_LENGTH_MIN = 3;
+const int MATCH_LENGTH_MAX = 258;
+
+const std::array<uint16_t, 29> LENGTH_BASE = {
+    3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+    35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+const std::array<uint8_t, 29> LENGTH_EXTRA_BITS = {
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+const std::array<uint16_t, 30> DISTANCE_BASE = {
+    1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+    257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+const std::array<uint8_t, 30> DISTANCE_EXTRA_BITS = {
+    0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+    7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+const size_t DISTANCE_MAX = 32768;
+
+// Fixed Huffman table, RFC 1951 section 3.2.6
+void write_literal_length(BitWriter& writer, int symbol)
+{
+    if (symbol < 144) {
+        writer.write_code(0x30 + symbol, 8);
+    } else if (symbol < 256) {
+        writer.write_code(0x190 + symbol - 144, 9);
+    } else if (symbol < 280) {
+        writer.write_code(symbol - 256, 7);
+    } else {
+        writer.write_code(0xC0 + symbol - 280, 8);
+    }
+}
+
+void write_match(BitWriter& writer, int length, int distance)
+{
+    int length_code = std::upper_bound(LENGTH_BASE.begin(), LENGTH_BASE.end(), length)
+        - LENGTH_BASE.begin() - 1;
+    write_literal_length(writer, 257 + length_code);
+    writer.write(length - LENGTH_BASE[length_code], LENGTH_EXTRA_BITS[length_code]);
+
+    int distance_code = std::upper_bound(DISTANCE_BASE.begin(), DISTANCE_BASE.end(), distance)
+        - DISTANCE_BASE.begin() - 1;
+    writer.write_code(distance_code, 5);
+    writer.write(distance - DISTANCE_BASE[distance_code], DISTANCE_EXTRA_BITS[distance_code]);
+}
+
+void append_u32(std::vector<uint8_t>& data, uint32_t value)
+{
+    data.push_back(value >> 24);
+    data.push_back(value >> 16);
+    data.push_back(value >> 8);
+    data.push_back(value);
+}
+
+} // namespace
+
+std::vector<uint8_t> PngEncoder::encode(const uint8_t* rgba, int width, int height, Mode mode)
+{
+    std::vector<uint8_t> png;
+    std::vector<uint32_t> palette;
+    std::vector<uint8_t> scanlines;
+    int bit_depth;
+
+    if (mode == Mode::COMPACT
+        || !build_indexed_image(rgba, width, height, palette, scanlines, bit_depth)) {
+        lodepng::encode(png, rgba, width, height);
+        return png;
+    }
+
+    static const uint8_t signature[] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    png.assign(std::begin(signature), std::end(signature));
+
+    std::vector<uint8_t> header;
+    append_u32(header, width);
+    append_u32(header, height);
+    header.push_back(bit_depth);
+    header.push_back(3); // indexed color
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering (only "none" is used)
+    header.push_back(0); // no interlacing
+    write_chunk(png, "IHDR", header);
+
+    std::vector<uint8_t> colors, alphas;
+    for (uint32_t color : palette) {
+        colors.push_back(color & 0xFF);
+        colors.push_back((color >> 8) & 0xFF);
+        colors.push_back((color >> 16) & 0xFF);
+        alphas.push_back(color >> 24);
+    }
+
+    write_chunk(png, "PLTE", colors);
+    write_chunk(png, "tRNS", alphas);
+
+    std::vector<uint8_t> zlib = { 0x78, 0x01 };
+    if (mode == Mode::STORED) {
+        deflate_stored(scanlines, zlib);
+    } else {
+        deflate_fast(scanlines, scanlines.size() / height, zlib);
+    }
+
+    append_u32(zlib, adler32(scanlines));
+    write_chunk(png, "IDAT", zlib);
+    write_chunk(png, "IEND", {});
+
+    return png;
+}
+
+bool PngEncoder::build_indexed_image(const uint8_t* rgba, int width, int height,
+    std::vector<uint32_t>& palette, std::vector<uint8_t>& scanlines, int& bit_depth)
+{
+    std::vector<uint8_t> indices(width * height);
+    const uint32_t* pixels = reinterpret_cast<const uint32_t*>(rgba);
+
+    // The images are mostly long runs of a few colors, so remembering the
+    // last lookup spares almost every palette search
+    uint32_t last_color = 0;
+    uint8_t last_index = 0;
+    bool has_last = false;
+
+    for (int i = 0; i < width * height; ++i) {
+        uint32_t color = pixels[i];
+        if (has_last && color == last_color) {
+            indices[i] = last_index;
+            continue;
+        }
+
+        auto it = std::find(palette.begin(), palette.end(), color);
+        if (it == palette.end()) {
+            if (palette.size() == PALETTE_SIZE_MAX) {
+                return false;
+            }
+
+            it = palette.insert(palette.end(), color);
+        }
+
+        last_color = color;
+        last_index = it - palette.begin();
+        has_last = true;
+        indices[i] = last_index;
+    }
+
+    bit_depth = palette.size() <= 2 ? 1 : palette.size() <= 4 ? 2 : palette.size() <= 16 ? 4 : 8;
+
+    int pixels_per_byte = 8 / bit_depth;
+    size_t row_bytes = (width + pixels_per_byte - 1) / pixels_per_byte;
+    scanlines.assign(height * (row_bytes + 1), 0);
+
+    for (int y = 0; y < height; ++y) {
+        uint8_t* row = &scanlines[y * (row_bytes + 1)];
+        row[0] = 0; // filter type "none"
+
+        const uint8_t* row_indices = &indices[y * width];
+        for (int x = 0; x < width; x += pixels_per_byte) {
+            int count = std::min(pixels_per_byte, width - x);
+            uint8_t packed = 0;
+            for (int i = 0; i < count; ++i) {
+                packed |= row_indices[x + i] << (8 - bit_depth * (i + 1));
+            }
+
+            row[1 + x / pixels_per_byte] = packed;
+        }
+    }
+
+    return true;
+}
+
+void PngEncoder::deflate_stored(const std::vector<uint8_t>& data, std::vector<uint8_t>& out)
+{
+    const size_t block_max = 65535;
+    size_t position = 0;
+
+    do {
+        size_t length = std::min(block_max, data.size() - position);
+        bool final = position + length == data.size();
+
+        out.push_back(final ? 1 : 0); // BFINAL, BTYPE = 00
+        out.push_back(length & 0xFF);
+        out.push_back(length >> 8);
+        out.push_back(~length & 0xFF);
+        out.push_back((~length >> 8) & 0xFF);
+        out.insert(out.end(), data.begin() + position, data.begin() + position + length);
+
+        position += length;
+    } while (position < data.size());
+}
+
+void PngEncoder::deflate_fast(const std::vector<uint8_t>& data, size_t stride,
+    std::vector<uint8_t>& out)
+{
+    BitWriter writer(out);
+    writer.write(1, 1); // BFINAL
+    writer.write(1, 2); // BTYPE = 01, fixed Huffman codes
+
+    auto match_length = [&](size_t position, size_t distance) {
+        size_t limit = std::min<size_t>(MATCH_LENGTH_MAX, data.size() - position);
+        size_t length = 0;
+        while (length < limit && data[position + length] == data[position + length - distance]) {
+            ++length;
+        }
+
+        return length;
+    };
+
+    size_t position = 0;
+    while (position < data.size()) {
+        // Only two candidates: a run of the previous byte
+        // and the same bytes one scanline above
+        size_t best_length = 0, best_distance = 0;
+
+        if (position >= stride && stride <= DISTANCE_MAX) {
+            best_length = match_length(position, stride);
+            best_distance = stride;
+        }
+
+        if (position >= 1 && best_length < MATCH_LENGTH_MAX) {
+            size_t length = match_length(position, 1);
+            if (length > best_length) {
+                best_length = length;
+                best_distance = 1;
+            }
+        }
+
+        if (best_length >= MATCH_LENGTH_MIN) {
+            write_match(writer, best_length, best_distance);
+            position += best_length;
+        } else {
+            write_literal_length(writer, data[position]);
+            ++position;
+        }
+    }
+
+    write_literal_length(writer, 256); // end of block
+    writer.flush();
+}
+
+void PngEncoder::write_chunk(std::vector<uint8_t>& png, const char* type,
+    const std::vector<uint8_t>& data)
+{
+    append_u32(png, data.size());
+
+    size_t type_position = png.size();
+    png.insert(png.end(), type, type + 4);
+    png.insert(png.end(), data.begin(), data.end());
+
+    append_u32(png, crc32(&png[type_position], png.size() - type_position));
+}
+
+uint32_t PngEncoder::crc32(const uint8_t* data, size_t size, uint32_t crc)
+{
+    static const auto table = [] {
+        std::array<uint32_t, 256> table;
+        for (uint32_t n = 0; n < 256; ++n) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k) {
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            }
+
+            table[n] = c;
+        }
+
+        return table;
+    }();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
+
+uint32_t PngEncoder::adler32(const std::vector<uint8_t>& data)
+{
+    const uint32_t modulo = 65521;
+    uint32_t a = 1, b = 0;
+
+    // 5552 is the largest block that can't overflow 32 bits before the modulo
+    for (size_t position = 0; position < data.size(); position += 5552) {
+        size_t end = std::min(position + 5552, data.size());
+        for (size_t i = position; i < end; ++i) {
+            a += data[i];
+            b += a;
+        }
+
+        a %= modulo;
+        b %= modulo;
+    }
+
+    return (b << 16) | a;
+}
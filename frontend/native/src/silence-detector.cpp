@@ -1,4 +1,5 @@
 #include<silence-detector.h>
+#include<algorithm>
 #include<cstdlib>
 
 SilenceDetector::SilenceDetector() 
@@ -34,4 +35,41 @@ void SilenceDetector::detect_silence(const int16_t* stem,uint32_t total_length)
     if (silence_length >= _silence_min_length) {
         _silences.push_back({silence_start,total_length});
     }
-}
\ No newline at end of file
+}
+
+bool SilenceDetector::is_silent(int32_t first_sample, int32_t length) const
+{
+    size_t interval = find_interval(first_sample + length);
+    return interval < _silences.size() && _silences[interval].first <= first_sample;
+}
+
+bool SilenceDetector::is_silent(int32_t first_sample, int32_t length, silence_cursor& cursor) const
+{
+    int32_t last_sample = first_sample + length;
+
+    if (first_sample < cursor.position || cursor.interval > _silences.size()) {
+        cursor.interval = find_interval(last_sample);
+    } else {
+        // Intervals are sorted and disjoint, so when moving forward
+        // the candidate interval can only move forward as well
+        while (cursor.interval < _silences.size() 
+            && _silences[cursor.interval].second < last_sample) {
+            ++cursor.interval;
+        }
+    }
+
+    cursor.position = first_sample;
+    return cursor.interval < _silences.size() 
+        && _silences[cursor.interval].first <= first_sample;
+}
+
+size_t SilenceDetector::find_interval(int32_t last_sample) const
+{
+    // The only interval that can contain a range ending at `last_sample`
+    // is the first one that ends at or after it
+    auto it = std::lower_bound(_silences.begin(), _silences.end(), last_sample,
+        [](const std::pair<int32_t,int32_t>& interval, int32_t sample) {
+            return interval.second < sample;
+        });
+    return it - _silences.begin();
+}
@@ -1,27 +1,80 @@
 #include <stem-manager.h>
 
 #include <audio-buffer.h>
-#include <stb_vorbis.h>
+#include <mix-kernel.h>
+#include <stem-stream.h>
 #include <utils.h>
+#include <vorbis-arena-pool.h>
+#include <vorbis-push-decoder.h>
 #include <waveform-renderer.h>
+#include <worker-pool.h>
 
 #include <base64.h>
 #include <emscripten/fetch.h>
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <cstdio>
+#include <cstring>
+#include <string>
 #include <thread>
 #include <unordered_set>
 
+// Should match -sPTHREAD_POOL_SIZE, see CMakeLists.txt
+#ifndef GS_PTHREAD_POOL_SIZE
+#define GS_PTHREAD_POOL_SIZE 32
+#endif
+
+// Mixing threads may take up to 1/8 of the pthread pool,
+// the rest is left for the background tasks
+#define MIX_HELPER_THREADS_MAX (GS_PTHREAD_POOL_SIZE / 8)
+
+// Downloads, decoding and waveform rendering share 1/4 of the pool
+#define BACKGROUND_THREADS (GS_PTHREAD_POOL_SIZE / 4)
+
+// Helpers splitting the columns of one waveform at a time
+#define WAVEFORM_HELPER_THREADS (GS_PTHREAD_POOL_SIZE / 8)
+
 
 const float StemManager::SHORT_TO_FLOAT = 1 / 32768.f;
 const int StemManager::STEM_DOWNLOAD_RETRY_COUNT = 4;
+// The first chunk holds the headers and the first few Ogg pages, so playback
+// can start early; later chunks grow to keep the request count low
+const uint64_t StemManager::STEM_DOWNLOAD_CHUNK_MIN = 64 * 1024;
+const uint64_t StemManager::STEM_DOWNLOAD_CHUNK_MAX = 1024 * 1024;
+const size_t StemManager::MIX_STEMS_PER_THREAD_MIN = 4;
+const int StemManager::STREAM_FILL_BLOCK_FRAMES = 8192;
+const int StemManager::WAVEFORM_WIDTH = 4096;
+const int StemManager::WAVEFORM_HEIGHT = 128;
 using std::nullopt;
 
 StemManager::StemManager()
     : _length(0)
+    , _decoder_arenas(std::make_shared<VorbisArenaPool>())
+    , _streaming_enabled(false)
+    , _stopping(false)
+{
+    // The mixer and the audio worklet already occupy one core each
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t helpers = cores > 2 ? cores - 2 : 0;
+    helpers = std::min<uint32_t>(helpers, MIX_HELPER_THREADS_MAX);
+
+    _mix_pool = std::make_unique<WorkerPool>(helpers);
+    _partial_buses = std::make_unique<audio_chunk[]>(helpers + 1);
+    _mix_thread_count = std::max<uint32_t>(1, std::min(helpers + 1, cores / 2));
+
+    _waveform_pool = std::make_unique<WorkerPool>(
+        std::min<uint32_t>(cores > 1 ? cores - 1 : 0, WAVEFORM_HELPER_THREADS));
+    _tasks = std::make_unique<TaskScheduler>(BACKGROUND_THREADS);
+    _stream_thread = std::thread(&StemManager::stream_thread_main, this);
+}
+
+StemManager::~StemManager()
 {
+    _tasks.reset();
+    _stopping = true;
+    _stream_thread.join();
 }
 
 void StemManager::set_track_length(uint32_t samples)
@@ -36,7 +89,7 @@ void StemManager::set_track_length(uint32_t samples)
             uint32_t prev_ordinal;
             {
                 std::lock_guard lock(stem_ptr->mutex);
-                stem_ptr->waveform_base64.clear();
+                stem_ptr->waveform_image.reset();
                 prev_ordinal = ++stem_ptr->waveform_ordinal;
             }
 
@@ -124,8 +177,44 @@ std::string StemManager::waveform_data_uri(uint32_t stem_id) const
 
     if (it == _stems.end()) return "";
 
+    auto image = waveform_image(stem_id);
+    if (!image) return "";
+
+    // Only encoded on request, the editor draws the raw image instead
+    auto png = WaveformRenderer::encode_png(
+        *image, WAVEFORM_WIDTH, WAVEFORM_HEIGHT, PngEncoder::Mode::FAST);
+    return "data:image/png;base64," + base64_encode(png.data(), png.size());
+}
+
+std::shared_ptr<const std::vector<uint8_t>> StemManager::waveform_image(uint32_t stem_id) const
+{
+    auto it = _stems.find(stem_id);
+
+    if (it == _stems.end()) return nullptr;
+
+    std::lock_guard lock(it->second->mutex);
+    return it->second->waveform_image;
+}
+
+std::shared_ptr<const std::vector<uint8_t>> StemManager::pin_waveform_image(uint32_t stem_id)
+{
+    auto it = _stems.find(stem_id);
+
+    if (it == _stems.end()) return nullptr;
+
     std::lock_guard lock(it->second->mutex);
-    return it->second->waveform_base64;
+    it->second->pinned_waveform_image = it->second->waveform_image;
+    return it->second->pinned_waveform_image;
+}
+
+int StemManager::waveform_width() const
+{
+    return WAVEFORM_WIDTH;
+}
+
+int StemManager::waveform_height() const
+{
+    return WAVEFORM_HEIGHT;
 }
 
 void StemManager::set_bg_task_complete_callback(std::function<void()> callback)
@@ -133,11 +222,50 @@ void StemManager::set_bg_task_complete_callback(std::function<void()> callback)
     _complete_cb = callback;
 }
 
+void StemManager::set_mix_thread_count(uint32_t count)
+{
+    _mix_thread_count = std::clamp<uint32_t>(count, 1, max_mix_thread_count());
+}
+
+uint32_t StemManager::mix_thread_count() const
+{
+    return _mix_thread_count;
+}
+
+uint32_t StemManager::max_mix_thread_count() const
+{
+    return _mix_pool->thread_count() + 1;
+}
+
+void StemManager::set_streaming_enabled(bool enabled)
+{
+    _streaming_enabled = enabled;
+}
+
+bool StemManager::streaming_enabled() const
+{
+    return _streaming_enabled;
+}
+
+size_t StemManager::background_queue_depth() const
+{
+    return _tasks->queue_depth();
+}
+
+std::vector<task_class_stats> StemManager::background_task_stats() const
+{
+    return _tasks->stats();
+}
+
 void StemManager::render(uint32_t first_sample, audio_chunk& chunk)
 {
     std::lock_guard main_lock(_mutex); // <-- this will be called from a worker thread
+
+    // Capacity is reserved whenever stems are added, so this doesn't allocate
+    _render_list.clear();
     for (const auto& [ stem_id, stem_ptr ] : _stems) {
-        if (!stem_ptr->data_ready || stem_ptr->deleted) {
+        bool playable = stem_ptr->data_ready || stem_ptr->decoded_samples > 0;
+        if (!playable || stem_ptr->deleted) {
             continue;
         }
 
@@ -145,39 +273,103 @@ void StemManager::render(uint32_t first_sample, audio_chunk& chunk)
             continue;
         }
 
-        std::lock_guard lock(stem_ptr->mutex);
+        _render_list.push_back(stem_ptr.get());
+    }
+
+    std::sort(_render_list.begin(), _render_list.end(), 
+        [](const StemEntry* a, const StemEntry* b) { return a->info.id < b->info.id; });
 
-        int stem_sample = first_sample - stem_ptr->info.offset;
-        bool is_silent = false;
-        for(auto&& [start,end] : stem_ptr->detector){
-            if((stem_sample >= start) && stem_sample <= end - AUDIO_CHUNK_SAMPLES){
-                is_silent = true;
-                break;
-            } 
+    size_t stem_count = _render_list.size();
+    size_t groups = std::min<size_t>(_mix_thread_count, stem_count / MIX_STEMS_PER_THREAD_MIN);
+
+    if (groups <= 1) {
+        for (StemEntry* stem : _render_list) {
+            render_stem(*stem, first_sample, chunk);
         }
-        if(is_silent){
-            continue;
+
+        return;
+    }
+
+    auto render_group = [&](size_t group) {
+        audio_chunk& bus = _partial_buses[group];
+        memset(&bus, 0, sizeof(audio_chunk));
+
+        size_t first_stem = group * stem_count / groups;
+        size_t last_stem = (group + 1) * stem_count / groups;
+        for (size_t i = first_stem; i < last_stem; ++i) {
+            render_stem(*_render_list[i], first_sample, bus);
         }
-        int stem_length = stem_ptr->info.samples;
-        float pan = stem_ptr->info.pan;
-        if (pan < -1.f) pan = -1.f;
-        if (pan > 1.f) pan = 1.f;
-
-        // Linear pan law
-        float gain_l = (1 - pan) * stem_ptr->gain * SHORT_TO_FLOAT;
-        float gain_r = (1 + pan) * stem_ptr->gain * SHORT_TO_FLOAT;
-
-        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i, ++stem_sample) {
-            if (stem_sample < 0 || stem_sample >= stem_length) {
-                continue;
+    };
+
+    _mix_pool->run(groups, render_group);
+
+    for (size_t group = 0; group < groups; ++group) {
+        const audio_chunk& bus = _partial_buses[group];
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            chunk.left_channel[i] += bus.left_channel[i];
+            chunk.right_channel[i] += bus.right_channel[i];
+        }
+    }
+}
+
+void StemManager::render_stem(StemEntry& stem, uint32_t first_sample, audio_chunk& chunk)
+{
+    std::lock_guard lock(stem.mutex);
+
+    // Stems that are still downloading only play their decoded prefix
+    bool complete = stem.data_ready;
+    int stem_sample = first_sample - stem.info.offset;
+    int stem_length = complete ? stem.info.samples 
+        : stem.decoded_samples.load(std::memory_order_acquire);
+
+    // Only the part of the quantum that overlaps the stem gets mixed,
+    // so the kernel itself doesn't need any bounds checks
+    int first_frame = std::max(0, -stem_sample);
+    int last_frame = std::min(AUDIO_CHUNK_SAMPLES, stem_length - stem_sample);
+
+    // The decoder follows the playhead even through silent parts
+    if (stem.stream) {
+        stem.stream->set_playhead(stem_sample + first_frame);
+    }
+
+    if (first_frame >= last_frame) {
+        return;
+    }
+
+    if (complete && stem.detector.is_silent(stem_sample, AUDIO_CHUNK_SAMPLES, stem.detector_cursor)) {
+        return;
+    }
+
+    float pan = stem.info.pan;
+    if (pan < -1.f) pan = -1.f;
+    if (pan > 1.f) pan = 1.f;
+
+    // Linear pan law
+    float gain_l = (1 - pan) * stem.gain * SHORT_TO_FLOAT;
+    float gain_r = (1 + pan) * stem.gain * SHORT_TO_FLOAT;
+
+    if (stem.stream) {
+        // The decoded window may wrap around the end of the ring, and frames
+        // that aren't decoded yet (right after a seek) are left silent
+        int frame = first_frame;
+        while (frame < last_frame) {
+            const int16_t* data;
+            int frames = stem.stream->acquire(stem_sample + frame, last_frame - frame, data);
+            if (frames == 0) {
+                break;
             }
 
-            chunk.left_channel[i] 
-                += stem_ptr->data[2 * stem_sample] * gain_l;
-            chunk.right_channel[i] 
-                += stem_ptr->data[2 * stem_sample + 1] * gain_r;
+            MixKernel::mix_stereo(data, frames, gain_l, gain_r,
+                chunk.left_channel + frame, chunk.right_channel + frame);
+            frame += frames;
         }
+
+        return;
     }
+
+    MixKernel::mix_stereo(stem.data + 2 * (stem_sample + first_frame), 
+        last_frame - first_frame, gain_l, gain_r, 
+        chunk.left_channel + first_frame, chunk.right_channel + first_frame);
 }
 
 void StemManager::update_stem_info(const std::vector<stem_info>& info)
@@ -248,13 +440,13 @@ void StemManager::update_or_add_stems(const std::vector<stem_info>& info)
             stem_ptr->info.pan = stem_info.pan;
         }
 
-        // invalidate waveform image if offset changed
+        // Re-render the waveform if offset changed. The previous image is
+        // kept until then, so dragging a stem doesn't flash the placeholder
         if (stem_ptr->info.offset != stem_info.offset) {
             uint32_t prev_ordinal;
             {
                 std::lock_guard lock(stem_ptr->mutex);
                 stem_ptr->info.offset = stem_info.offset;
-                stem_ptr->waveform_base64.clear();
                 prev_ordinal = ++stem_ptr->waveform_ordinal;
             }
 
@@ -268,6 +460,8 @@ void StemManager::update_or_add_stems(const std::vector<stem_info>& info)
         for (StemEntryPtr& new_stem : stems_to_add) {
             _stems[new_stem->info.id] = new_stem;
         }
+
+        _render_list.reserve(_stems.size());
     }
 }
 
@@ -276,12 +470,16 @@ auto StemManager::create_stem_from_info(const stem_info& info) -> StemEntryPtr
     StemEntryPtr new_stem = std::make_shared<StemEntry>();
     new_stem->info = info;
     new_stem->data = nullptr;
-    new_stem->data_block = "";
+    new_stem->data_block = nullptr;
     new_stem->data_ready = false;
+    new_stem->decoded_samples = 0;
     new_stem->deleted = false;
     new_stem->error = false;
     new_stem->waveform_ordinal = 0;
-    new_stem->waveform_base64 = "";
+    new_stem->waveform_image = nullptr;
+    new_stem->pinned_waveform_image = nullptr;
+    new_stem->columns = nullptr;
+    new_stem->detector_cursor = { 0, 0 };
     new_stem->gain = Utils::decibels_to_gain(info.gain_db);
 
     run_stem_processing(new_stem);
@@ -289,128 +487,228 @@ auto StemManager::create_stem_from_info(const stem_info& info) -> StemEntryPtr
     return new_stem;
 }
 
+auto StemManager::cancellation_token(const StemEntryPtr& stem) -> TaskScheduler::CancellationToken
+{
+    // Shares the ownership of the stem, so the flag outlives the entry
+    return TaskScheduler::CancellationToken(stem, &stem->deleted);
+}
+
 void StemManager::run_stem_processing(StemEntryPtr stem)
 {
     auto cb = _complete_cb;
 
-    std::thread thread([this, stem, cb]() {
+    _tasks->submit(TaskScheduler::Priority::DECODE, [this, stem, cb]() {
         process_stem(stem);
         cb();
-    });
-
-    thread.detach();
+    }, cancellation_token(stem));
 }
 
 void StemManager::run_waveform_processing(StemEntryPtr stem, uint32_t prev_ordinal)
 {
     auto cb = _complete_cb;
 
-    std::thread thread([this, stem, cb, prev_ordinal]() {
-        process_stem_waveform(stem, prev_ordinal);
-        cb();
-    });
-    
-    thread.detach();
+    // A newer waveform request for the same stem replaces the queued one
+    _tasks->submit_coalesced(TaskScheduler::Priority::WAVEFORM, stem->info.id, 
+        [this, stem, cb, prev_ordinal]() {
+            process_stem_waveform(stem, prev_ordinal);
+            cb();
+        }, cancellation_token(stem));
 }
 
 void StemManager::process_stem(StemEntryPtr stem)
+{
+    uint32_t sid = stem->info.id;
+    bool streaming = _streaming_enabled;
+
+    // The output gets its final size up front, so the mixer can already
+    // play the decoded prefix while the rest is being downloaded
+    auto pcm = std::make_shared<std::string>(2 * stem->info.samples * sizeof(int16_t), '\0');
+    {
+        std::lock_guard lock(stem->mutex);
+        stem->data_block = pcm;
+        stem->data = reinterpret_cast<const int16_t*>(pcm->data());
+    }
+
+    VorbisPushDecoder decoder(
+        reinterpret_cast<int16_t*>(pcm->data()), stem->info.samples, _decoder_arenas);
+    std::string compressed;
+    uint64_t downloaded = 0;
+    uint64_t chunk_size = STEM_DOWNLOAD_CHUNK_MIN;
+    bool last = false;
+
+    printf("Stem %u: Downloading \"%s\"\n", sid, stem->info.path.c_str());
+
+    while (!last) {
+        std::string chunk;
+        if (!download_range(stem, downloaded, chunk_size, chunk, last)) {
+            stem->decoded_samples = 0;
+            if (!stem->deleted) {
+                stem->error = true;
+            }
+
+            return;
+        }
+
+        if (stem->deleted) return;
+
+        if (!decoder.feed(chunk.data(), chunk.size())) {
+            fprintf(stderr, "Stem %u: Vorbis decoding failed!\n", sid);
+            stem->decoded_samples = 0;
+            stem->error = true;
+            return;
+        }
+
+        stem->decoded_samples.store(decoder.decoded_frames(), std::memory_order_release);
+
+        downloaded += chunk.size();
+        chunk_size = std::min(2 * chunk_size, STEM_DOWNLOAD_CHUNK_MAX);
+
+        if (streaming) {
+            compressed += chunk;
+        }
+    }
+
+    printf("Stem %u: Download finished. Got %llu bytes.\n", 
+        sid, static_cast<unsigned long long>(downloaded));
+
+    if (decoder.decoded_frames() != stem->info.samples) {
+        fprintf(stderr, "Stem %u: Vorbis decoding failed! Got %u of %u samples.\n", 
+            sid, decoder.decoded_frames(), stem->info.samples);
+        stem->decoded_samples = 0;
+        stem->error = true;
+        return;
+    }
+
+    std::unique_ptr<StemStream> stream;
+    if (streaming) {
+        stream = std::make_unique<StemStream>(
+            std::move(compressed), stem->info.samples, _decoder_arenas);
+
+        if (!stream->open()) {
+            fprintf(stderr, "Stem %u: Couldn't open the vorbis stream, "
+                "falling back to the decoded data\n", sid);
+            stream.reset();
+        }
+    }
+
+    printf("Stem %u: Vorbis data has been decoded.\n", sid);
+    stem->detector.detect_silence(
+        reinterpret_cast<const int16_t*>(pcm->data()), stem->info.samples);
+    stem->peaks.build(reinterpret_cast<const int16_t*>(pcm->data()), stem->info.samples);
+
+    // Waveforms are drawn from the peak pyramid, so in streaming mode
+    // the decoded data isn't needed anymore
+    if (stream) {
+        printf("Stem %u: Streaming, using %zu bytes instead of %zu.\n", sid,
+            stream->memory_usage(), pcm->size());
+
+        std::lock_guard lock(stem->mutex);
+        stem->stream = std::move(stream);
+        stem->data = nullptr;
+        stem->data_block.reset();
+    }
+
+    stem->data_ready = true;
+    process_stem_waveform(stem, 0);
+
+    printf("Stem %u: Initial waveform image has been generated.\n", sid);
+}
+
+bool StemManager::download_range(StemEntryPtr stem, uint64_t first_byte, 
+    uint64_t length, std::string& out, bool& last)
 {
     using namespace std::chrono_literals;
 
     uint32_t sid = stem->info.id;
-    emscripten_fetch_t* fetch = nullptr;
+    std::string range = "bytes=" + std::to_string(first_byte) 
+        + "-" + std::to_string(first_byte + length - 1);
+    const char* headers[] = { "Range", range.c_str(), nullptr };
 
     emscripten_fetch_attr_t attr;
     emscripten_fetch_attr_init(&attr);
     strcpy(attr.requestMethod, "GET");
     attr.attributes = EMSCRIPTEN_FETCH_LOAD_TO_MEMORY | EMSCRIPTEN_FETCH_SYNCHRONOUS;
+    attr.requestHeaders = headers;
 
     for (int approach = 0; approach < STEM_DOWNLOAD_RETRY_COUNT; ++approach) {
-        printf("Stem %u: Downloading \"%s\"\n", sid, stem->info.path.c_str());
+        emscripten_fetch_t* fetch = emscripten_fetch(&attr, stem->info.path.c_str());
 
-        fetch = emscripten_fetch(&attr, stem->info.path.c_str());
-
-        if (fetch->status < 200 || fetch->status > 299) {
-            // If download failed...
-
-            fprintf(stderr, "Stem %u: Download failed! Retrying %d more time(s)...\n", 
-                sid, STEM_DOWNLOAD_RETRY_COUNT - approach - 1);
+        if (fetch->status == 206) {
+            // Partial content, a short chunk means the end of the file
+            out.assign(fetch->data, fetch->numBytes);
+            last = fetch->numBytes < length;
             emscripten_fetch_close(fetch);
+            return true;
+        }
 
-            if (approach + 1 == STEM_DOWNLOAD_RETRY_COUNT) {
-                fprintf(stderr, "Stem %u: Download failed completely!\n", sid);
-                stem->error = true;
-
-                return;
-            }
-
-            // Wait before next download try
-            std::this_thread::sleep_for(3s);
-
-            if (stem->deleted) {
-                return;
-            }
-        } else {
-            // If download was successful...
+        if (fetch->status == 416) {
+            // Range not satisfiable, the previous chunk ended exactly at the end
+            out.clear();
+            last = true;
+            emscripten_fetch_close(fetch);
+            return true;
+        }
 
-            if (stem->deleted) {
-                emscripten_fetch_close(fetch);
-                return;
+        if (fetch->status >= 200 && fetch->status <= 299) {
+            // The server ignored the range and sent the whole file
+            out.clear();
+            if (first_byte < fetch->numBytes) {
+                out.assign(fetch->data + first_byte, fetch->numBytes - first_byte);
             }
 
-            break;
+            last = true;
+            emscripten_fetch_close(fetch);
+            return true;
         }
-    }
-
-    printf("Stem %u: Download finished. Got %llu bytes. Starting vorbis decoder...\n", 
-        sid, fetch->numBytes);
 
-    bool vorbis_ok = decode_vorbis_stream(stem, fetch->data, fetch->numBytes);
-    emscripten_fetch_close(fetch);
+        fprintf(stderr, "Stem %u: Download failed! Retrying %d more time(s)...\n", 
+            sid, STEM_DOWNLOAD_RETRY_COUNT - approach - 1);
+        emscripten_fetch_close(fetch);
 
-    if (stem->deleted) return;
+        if (approach + 1 == STEM_DOWNLOAD_RETRY_COUNT) {
+            fprintf(stderr, "Stem %u: Download failed completely!\n", sid);
+            return false;
+        }
 
-    if (vorbis_ok) {
-        printf("Stem %u: Vorbis data has been decoded.\n", sid);
-        stem->detector.detect_silence(stem->data,stem->info.samples);
-        stem->data_ready = true;
-        process_stem_waveform(stem, 0);
+        // Wait before next download try
+        std::this_thread::sleep_for(3s);
 
-        printf("Stem %u: Initial waveform image has been generated.\n", sid);
-    } else {
-        fprintf(stderr, "Stem %u: Vorbis decoding failed!\n", sid);
-        stem->error = true;
+        if (stem->deleted) {
+            return false;
+        }
     }
+
+    return false;
 }
 
-bool StemManager::decode_vorbis_stream(
-    StemEntryPtr stem, const char* data, uint32_t data_size)
+void StemManager::stream_thread_main()
 {
-    stem->data_block.resize(2 * stem->info.samples * sizeof(int16_t));
-
-    const unsigned char* in_data = reinterpret_cast<const unsigned char*>(data);
-    int16_t* out_data = reinterpret_cast<int16_t*>(stem->data_block.data());
-    stem->data = out_data;
+    using namespace std::chrono_literals;
 
-    int samples_processed = 0;
-    int vorbis_error = 0;
-    int limit = 2 * stem->info.samples;
+    std::vector<StemEntryPtr> streamed_stems;
 
-    stb_vorbis* vorbis = stb_vorbis_open_memory(in_data, data_size, &vorbis_error, NULL);
-    if (vorbis == nullptr) {
-        stem->data_block.clear();
-        return false;
-    }
+    while (!_stopping) {
+        streamed_stems.clear();
+        {
+            std::lock_guard lock(_mutex);
+            for (const auto& [ stem_id, stem_ptr ] : _stems) {
+                if (stem_ptr->data_ready && stem_ptr->stream) {
+                    streamed_stems.push_back(stem_ptr);
+                }
+            }
+        }
 
-    int samples;
-    while ((samples = stb_vorbis_get_frame_short_interleaved(
-        vorbis, 2, out_data + samples_processed, limit - samples_processed))) {
+        // Stems are filled in small blocks round-robin, so a seek doesn't
+        // leave the last stem waiting until all the others are full
+        bool busy = false;
+        for (const auto& stem : streamed_stems) {
+            busy |= stem->stream->fill(STREAM_FILL_BLOCK_FRAMES);
+        }
 
-        samples_processed += 2 * samples;
+        if (!busy) {
+            std::this_thread::sleep_for(5ms);
+        }
     }
-
-    stb_vorbis_close(vorbis);
-    return samples_processed == limit;
 }
 
 void StemManager::process_stem_waveform(StemEntryPtr stem, uint32_t prev_ordinal)
@@ -420,24 +718,47 @@ void StemManager::process_stem_waveform(StemEntryPtr stem, uint32_t prev_ordinal
         return;
     }
 
-    WaveformRenderer renderer(stem->detector);
+    WaveformRenderer renderer(WAVEFORM_WIDTH, WAVEFORM_HEIGHT, stem->detector);
     renderer.set_silence_alpha(140);
+    renderer.set_worker_pool(_waveform_pool.get());
 
     int32_t stem_offset;
     uint32_t track_length = _length;
+    std::shared_ptr<const waveform_columns> cached_columns;
     {
         std::lock_guard lock(stem->mutex);
         stem_offset = stem->info.offset;
+        cached_columns = stem->columns;
     }
 
-    auto png = renderer.render_waveform_to_png(
-        stem_offset, track_length, stem->data, stem->info.samples);
-    std::string data_uri = "data:image/png;base64," + base64_encode(png.data(), png.size());
+    // Offset changes only translate the columns of the last full render,
+    // anything else needs the columns computed from scratch
+    std::shared_ptr<const waveform_columns> new_columns;
+    WaveformRenderer::ColumnPeaks column_peaks;
+
+    if (cached_columns && cached_columns->track_length == track_length) {
+        column_peaks = renderer.shift_column_peaks(cached_columns->peaks, 
+            cached_columns->offset, stem_offset, track_length, stem->peaks);
+    } else {
+        new_columns = std::make_shared<const waveform_columns>(waveform_columns{
+            .offset = stem_offset,
+            .track_length = track_length,
+            .peaks = renderer.compute_column_peaks(stem_offset, track_length, stem->peaks),
+        });
+    }
+
+    auto image = std::make_shared<const std::vector<uint8_t>>(renderer.render_waveform(
+        stem_offset, track_length, new_columns ? new_columns->peaks : column_peaks, 
+        stem->info.samples));
     
     {
         std::lock_guard lock(stem->mutex);
         if (stem->waveform_ordinal == prev_ordinal) {
-            stem->waveform_base64 = std::move(data_uri);
+            stem->waveform_image = std::move(image);
+            if (new_columns) {
+                stem->columns = std::move(new_columns);
+            }
+
             ++stem->waveform_ordinal;
         } else {
             printf("Stem %u: Waveform not saved due to being obsolete (%u != %u)!\n", 
@@ -0,0 +1,172 @@
+#include <stem-stream.h>
+
+#include <audio-buffer.h>
+#include <stb_vorbis.h>
+#include <vorbis-arena-pool.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+
+// ~5.9 seconds of stereo int16 audio (1 MiB), must be a power of two
+const int32_t StemStream::RING_FRAMES = 1 << 18;
+// A seek costs about as much as decoding 2-4k frames (stem-stream-bench),
+// so jumping further ahead than this seeks instead of decoding up to it
+const int32_t StemStream::SEEK_DISTANCE_FRAMES = 4096;
+// The decoder never fills the whole ring, so the quantum that is being
+// read right now is never overwritten
+const int32_t StemStream::READ_AHEAD_MARGIN_FRAMES = 2 * AUDIO_CHUNK_SAMPLES;
+
+StemStream::StemStream(std::string compressed_data, uint32_t total_frames,
+    std::shared_ptr<VorbisArenaPool> arenas)
+    : _compressed_data(std::move(compressed_data))
+    , _total_frames(total_frames)
+    , _arenas(std::move(arenas))
+    , _vorbis(nullptr)
+    , _ring(std::make_unique<int16_t[]>(2 * RING_FRAMES))
+    , _playhead(0)
+    , _window_start(0)
+    , _window_end(0)
+{
+}
+
+StemStream::~StemStream()
+{
+    if (_vorbis) {
+        stb_vorbis_close(_vorbis);
+    }
+
+    if (!_arena.empty()) {
+        _arenas->release(std::move(_arena));
+    }
+}
+
+bool StemStream::open()
+{
+    int vorbis_error = 0;
+    _vorbis = _arenas->open(_arena, vorbis_error, [&](const stb_vorbis_alloc* alloc, int* error) {
+        return stb_vorbis_open_memory(
+            reinterpret_cast<const unsigned char*>(_compressed_data.data()),
+            _compressed_data.size(), error, alloc);
+    });
+
+    return _vorbis != nullptr;
+}
+
+const std::string& StemStream::compressed_data() const
+{
+    return _compressed_data;
+}
+
+size_t StemStream::memory_usage() const
+{
+    return _compressed_data.size() + 2 * RING_FRAMES * sizeof(int16_t) + _arena.size();
+}
+
+void StemStream::set_playhead(int32_t frame)
+{
+    _playhead.store(std::max(frame, 0));
+}
+
+int StemStream::acquire(int32_t first_frame, int frames, const int16_t*& data) const
+{
+    int32_t window_start = _window_start.load();
+    int32_t window_end = _window_end.load();
+
+    if (first_frame < window_start || first_frame >= window_end) {
+        return 0;
+    }
+
+    int32_t slot = first_frame & (RING_FRAMES - 1);
+    int available = std::min({ frames, window_end - first_frame, RING_FRAMES - slot });
+
+    data = &_ring[2 * slot];
+    return available;
+}
+
+bool StemStream::fill(int max_frames)
+{
+    if (_vorbis == nullptr) {
+        return false;
+    }
+
+    int32_t playhead = _playhead.load();
+    if (playhead >= _total_frames) {
+        return false;
+    }
+
+    int32_t window_start = _window_start.load();
+    int32_t window_end = _window_end.load();
+
+    if (playhead < window_start || playhead > window_end + SEEK_DISTANCE_FRAMES) {
+        seek(playhead);
+        window_start = window_end = playhead;
+    }
+
+    int32_t target_end = std::min(playhead + RING_FRAMES - READ_AHEAD_MARGIN_FRAMES, _total_frames);
+    if (window_end >= target_end) {
+        return false;
+    }
+
+    // While the mixer is still waiting for the frames at the playhead (after
+    // a seek), only the first quantum is decoded, so that the other stems
+    // get their turn sooner
+    if (window_end < playhead + AUDIO_CHUNK_SAMPLES) {
+        max_frames = std::min(max_frames, playhead + AUDIO_CHUNK_SAMPLES - window_end);
+    }
+
+    int32_t first_frame = window_end;
+    int32_t last_frame = std::min(target_end, first_frame + max_frames);
+
+    // Frames that share ring slots with [first_frame, last_frame) leave the
+    // window before they get overwritten...
+    int32_t new_window_start = std::max(window_start, last_frame - RING_FRAMES);
+    _window_start.store(new_window_start);
+
+    // ...and the playhead is checked again afterwards. If the mixer jumped
+    // outside of the safe range in the meantime, the next call will seek.
+    int32_t current_playhead = _playhead.load();
+    if (current_playhead < new_window_start
+        || current_playhead + AUDIO_CHUNK_SAMPLES > first_frame + RING_FRAMES) {
+        return true;
+    }
+
+    _window_end.store(decode_into_ring(first_frame, last_frame));
+    return true;
+}
+
+void StemStream::seek(int32_t frame)
+{
+    // Empty the window first, so that the mixer stops reading from it
+    _window_end.store(frame);
+    _window_start.store(frame);
+
+    if (!stb_vorbis_seek(_vorbis, frame)) {
+        fprintf(stderr, "[StemStream] Seek to frame %d failed!\n", frame);
+    }
+}
+
+int32_t StemStream::decode_into_ring(int32_t first_frame, int32_t last_frame)
+{
+    int32_t frame = first_frame;
+
+    while (frame < last_frame) {
+        int32_t slot = frame & (RING_FRAMES - 1);
+        int32_t frames = std::min(last_frame - frame, RING_FRAMES - slot);
+
+        int decoded = stb_vorbis_get_samples_short_interleaved(
+            _vorbis, 2, &_ring[2 * slot], 2 * frames);
+
+        if (decoded <= 0) {
+            // The stream is shorter than declared, pad it with silence
+            // instead of trying to decode the same frames over and over
+            memset(&_ring[2 * slot], 0, 2 * frames * sizeof(int16_t));
+            decoded = frames;
+        }
+
+        frame += decoded;
+    }
+
+    return frame;
+}
@@ -0,0 +1,152 @@
+#include <task-scheduler.h>
+
+#include <algorithm>
+
+
+const char* const TaskScheduler::PRIORITY_NAMES[PRIORITY_COUNT] = { "decode", "waveform" };
+
+TaskScheduler::TaskScheduler(size_t thread_count)
+    : _stopping(false)
+{
+    for (size_t i = 0; i < thread_count; ++i) {
+        _threads.emplace_back(&TaskScheduler::thread_main, this);
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    {
+        std::lock_guard lock(_mutex);
+        _stopping = true;
+    }
+
+    _cv.notify_all();
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+void TaskScheduler::submit(Priority priority, Task task, CancellationToken token)
+{
+    enqueue(priority, { std::move(task), std::move(token), std::nullopt, Clock::now() });
+}
+
+void TaskScheduler::submit_coalesced(
+    Priority priority, uint64_t key, Task task, CancellationToken token)
+{
+    enqueue(priority, { std::move(task), std::move(token), key, Clock::now() });
+}
+
+size_t TaskScheduler::thread_count() const
+{
+    return _threads.size();
+}
+
+size_t TaskScheduler::queue_depth() const
+{
+    std::lock_guard lock(_mutex);
+
+    size_t depth = 0;
+    for (const auto& queue : _queues) {
+        depth += queue.size();
+    }
+
+    return depth;
+}
+
+std::vector<task_class_stats> TaskScheduler::stats() const
+{
+    std::lock_guard lock(_mutex);
+    std::vector<task_class_stats> result;
+
+    for (size_t i = 0; i < PRIORITY_COUNT; ++i) {
+        const class_counters& counters = _counters[i];
+        double completed = std::max<uint32_t>(counters.completed, 1);
+
+        result.push_back({
+            .name = PRIORITY_NAMES[i],
+            .queued = static_cast<uint32_t>(_queues[i].size()),
+            .running = counters.running,
+            .completed = counters.completed,
+            .cancelled = counters.cancelled,
+            .coalesced = counters.coalesced,
+            .average_wait_ms = counters.total_wait_ms / completed,
+            .average_run_ms = counters.total_run_ms / completed,
+            .max_run_ms = counters.max_run_ms,
+        });
+    }
+
+    return result;
+}
+
+void TaskScheduler::enqueue(Priority priority, queued_task task)
+{
+    size_t index = static_cast<size_t>(priority);
+
+    {
+        std::lock_guard lock(_mutex);
+        auto& queue = _queues[index];
+
+        if (task.key.has_value()) {
+            auto it = std::find_if(queue.begin(), queue.end(),
+                [&](const queued_task& queued) { return queued.key == task.key; });
+
+            if (it != queue.end()) {
+                // The superseded task keeps its place in the queue,
+                // so a steady stream of updates can't starve it
+                it->task = std::move(task.task);
+                it->token = std::move(task.token);
+                ++_counters[index].coalesced;
+                return;
+            }
+        }
+
+        queue.push_back(std::move(task));
+    }
+
+    _cv.notify_one();
+}
+
+void TaskScheduler::thread_main()
+{
+    std::unique_lock lock(_mutex);
+
+    while (!_stopping) {
+        auto queue = std::find_if(std::begin(_queues), std::end(_queues),
+            [](const auto& queue) { return !queue.empty(); });
+
+        if (queue == std::end(_queues)) {
+            _cv.wait(lock);
+            continue;
+        }
+
+        class_counters& counters = _counters[queue - std::begin(_queues)];
+        queued_task task = std::move(queue->front());
+        queue->pop_front();
+
+        if (task.token && *task.token) {
+            ++counters.cancelled;
+            continue;
+        }
+
+        ++counters.running;
+        lock.unlock();
+
+        Clock::time_point started = Clock::now();
+        task.task();
+        Clock::time_point finished = Clock::now();
+
+        double wait_ms = std::chrono::duration<double, std::milli>(started - task.submitted).count();
+        double run_ms = std::chrono::duration<double, std::milli>(finished - started).count();
+
+        // Release whatever the task captured before taking the lock again
+        task = {};
+
+        lock.lock();
+        --counters.running;
+        ++counters.completed;
+        counters.total_wait_ms += wait_ms;
+        counters.total_run_ms += run_ms;
+        counters.max_run_ms = std::max(counters.max_run_ms, run_ms);
+    }
+}
@@ -2,111 +2,186 @@
 
 #include <audio-buffer.h>
 
+#include <algorithm>
+#include <cmath>
+
 
 const int Tempo::TICKS_PER_STEP = 4;
 
 Tempo::Tempo()
-    : _mode(TempoMode::STABLE)
-    , _stable_bpm(120.)
-    , _stable_time_sig(4)
-    , _last_varying_segment(0)
+    : _map(nullptr)
+    , _active_readers(0)
 {
-    _stable_samples_per_beat = samples_per_beat_from_bpm(_stable_bpm);
+    set_stable_bpm(120., 4);
 }
 
-void Tempo::set_stable_bpm(double bpm, uint32_t time_signature_numerator)
+Tempo::~Tempo()
 {
-    std::lock_guard lock(_mutex);
+    delete _map.load();
+}
 
-    _mode = TempoMode::STABLE;
-    _stable_bpm = bpm;
-    _stable_samples_per_beat = samples_per_beat_from_bpm(bpm);
-    _stable_time_sig = time_signature_numerator;
+void Tempo::set_stable_bpm(double bpm, uint32_t time_signature_numerator)
+{
+    auto map = std::make_unique<tempo_map>();
+    map->mode = TempoMode::STABLE;
+    map->stable_bpm = bpm;
+    map->stable_samples_per_beat = samples_per_beat_from_bpm(bpm);
+    map->stable_time_sig = time_signature_numerator;
+    map->last_varying_segment = 0;
+    build_beat_grid(*map);
+
+    publish(std::move(map));
 }
 
 void Tempo::set_varying_bpm(const std::vector<tempo_tag>& tempo_def)
 {
-    std::lock_guard lock(_mutex);
-    
-    _mode = TempoMode::VARYING;
-    _varying_bpm = tempo_def;
-    _last_varying_segment = 0;
+    auto map = std::make_unique<tempo_map>();
+    map->mode = TempoMode::VARYING;
+    map->stable_bpm = 0.;
+    map->stable_samples_per_beat = 0.;
+    map->stable_time_sig = 0;
+    map->varying_bpm = tempo_def;
+    map->last_varying_segment = 0;
+    build_beat_grid(*map);
+
+    publish(std::move(map));
+}
+
+void Tempo::publish(std::unique_ptr<tempo_map> map)
+{
+    std::lock_guard lock(_writer_mutex);
+
+    const tempo_map* previous = _map.exchange(map.release());
+    if (previous) {
+        _retired_maps.emplace_back(previous);
+    }
+
+    // Readers that are still running may use any of the retired snapshots,
+    // readers that start from now on can only see the new one
+    if (_active_readers.load() == 0) {
+        _retired_maps.clear();
+    }
 }
 
 bool Tempo::bpm_stable() const
 {
-    std::lock_guard lock(_mutex);
-    return _mode == TempoMode::STABLE;
+    return read([](const tempo_map& map) {
+        return map.mode == TempoMode::STABLE;
+    });
 }
 
 bool Tempo::bpm_varying() const
 {
-    std::lock_guard lock(_mutex);
-    return _mode == TempoMode::VARYING;
+    return read([](const tempo_map& map) {
+        return map.mode == TempoMode::VARYING;
+    });
 }
 
 double Tempo::current_bpm(uint32_t track_position) const
 {
-    std::lock_guard lock(_mutex);
-
-    if (_mode == TempoMode::STABLE) {
-        return _stable_bpm;
-    }
+    return read([&](const tempo_map& map) {
+        if (map.mode == TempoMode::STABLE) {
+            return map.stable_bpm;
+        }
 
-    if (_varying_bpm.size() < 2) {
-        return 0.;
-    }
+        if (map.varying_bpm.size() < 2) {
+            return 0.;
+        }
 
-    return varying_current_bpm(track_position);
+        return varying_current_bpm(map, track_position);
+    });
 }
 
 uint32_t Tempo::current_time_signature(uint32_t track_position) const
 {
-    std::lock_guard lock(_mutex);
-
-    if (_mode == TempoMode::STABLE) {
-        return _stable_time_sig;
-    }
+    return read([&](const tempo_map& map) -> uint32_t {
+        if (map.mode == TempoMode::STABLE) {
+            return map.stable_time_sig;
+        }
 
-    if (_varying_bpm.size() < 2) {
-        return 0;
-    }
+        if (map.varying_bpm.size() < 2) {
+            return 0;
+        }
 
-    return varying_current_time_signature(track_position);
+        return varying_current_time_signature(map, track_position);
+    });
 }
 
 song_position Tempo::current_position(uint32_t track_position) const
 {
-    std::lock_guard lock(_mutex);
-
-    if (_mode == TempoMode::STABLE) {
-        return stable_current_position(track_position);
-    }
+    return read([&](const tempo_map& map) {
+        if (map.mode == TempoMode::STABLE) {
+            return stable_current_position(map, track_position);
+        }
 
-    if (_varying_bpm.size() < 2) {
-        return song_position {
-            .bar = 0,
-            .step = 0,
-            .tick = 0,
-        };
-    }
+        if (map.varying_bpm.size() < 2) {
+            return song_position {
+                .bar = 0,
+                .step = 0,
+                .tick = 0,
+            };
+        }
 
-    return varying_current_position(track_position);
+        return varying_current_position(map, track_position);
+    });
 }
 
 uint32_t Tempo::bar_sample(uint32_t bar) const
 {
-    std::lock_guard lock(_mutex);
+    return read([&](const tempo_map& map) -> uint32_t {
+        if (map.mode == TempoMode::STABLE) {
+            return stable_bar_sample(map, bar);
+        }
 
-    if (_mode == TempoMode::STABLE) {
-        return stable_bar_sample(bar);
-    }
+        if (map.varying_bpm.size() < 2) {
+            return 0;
+        }
 
-    if (_varying_bpm.size() < 2) {
-        return 0;
-    }
+        return varying_bar_sample(map, bar);
+    });
+}
+
+size_t Tempo::beats_in_range(uint32_t first_sample, uint32_t last_sample,
+    beat_event* beats, size_t max_beats) const
+{
+    return read([&](const tempo_map& map) {
+        size_t count = 0;
+
+        auto it = std::lower_bound(map.beat_grid.begin(), map.beat_grid.end(), first_sample,
+            [](const beat_event& beat, uint32_t sample) { return beat.sample < sample; });
+        for (; it != map.beat_grid.end() && it->sample < last_sample && count < max_beats; ++it) {
+            beats[count++] = *it;
+        }
+
+        if (!map.open_segment) {
+            return count;
+        }
 
-    return varying_bar_sample(bar);
+        const auto& segment = *map.open_segment;
+        uint32_t from_sample = std::max(first_sample, map.open_segment_from);
+        if (from_sample >= last_sample) {
+            return count;
+        }
+
+        uint32_t step = segment_whole_steps(segment, from_sample);
+        if (segment_step_sample(segment, step) < from_sample) {
+            ++step;
+        }
+
+        for (; count < max_beats; ++step) {
+            uint32_t sample = segment_step_sample(segment, step);
+            if (sample >= last_sample) {
+                break;
+            }
+
+            beats[count++] = beat_event {
+                .sample = sample,
+                .bar_start = step % segment.time_sig == 0,
+            };
+        }
+
+        return count;
+    });
 }
 
 double Tempo::samples_per_beat_from_bpm(double bpm)
@@ -114,35 +189,117 @@ double Tempo::samples_per_beat_from_bpm(double bpm)
     return AUDIO_SAMPLE_RATE * 60 / bpm;
 }
 
-song_position Tempo::stable_current_position(uint32_t track_position) const
+void Tempo::build_beat_grid(tempo_map& map)
+{
+    map.beat_grid.clear();
+    map.open_segment.reset();
+    map.open_segment_from = 0;
+
+    if (map.mode == TempoMode::STABLE) {
+        if (map.stable_samples_per_beat > 0. && map.stable_time_sig > 0) {
+            map.open_segment = beat_segment {
+                .start_sample = 0,
+                .sample_delta = map.stable_samples_per_beat,
+                .step_delta = 1.,
+                .time_sig = map.stable_time_sig,
+            };
+        }
+
+        return;
+    }
+
+    const auto& tags = map.varying_bpm;
+    for (size_t i = 0; i + 1 < tags.size(); ++i) {
+        // The deltas are unsigned, so tags that don't move forward would
+        // wrap around to billions of steps instead of being skipped
+        if (tags[i + 1].sample <= tags[i].sample || tags[i + 1].bar <= tags[i].bar) {
+            continue;
+        }
+
+        beat_segment segment = {
+            .start_sample = tags[i].sample,
+            .sample_delta = static_cast<double>(tags[i + 1].sample - tags[i].sample),
+            .step_delta = static_cast<double>(
+                (tags[i + 1].bar - tags[i].bar) * tags[i].time_signature_numerator),
+            .time_sig = tags[i].time_signature_numerator,
+        };
+
+        if (segment.step_delta <= 0.) {
+            continue;
+        }
+
+        // The last segment goes on past the last tag
+        if (i + 2 == tags.size()) {
+            map.open_segment = segment;
+            map.open_segment_from = tags[i + 1].sample;
+        }
+
+        uint32_t steps = static_cast<uint32_t>(segment.step_delta);
+        for (uint32_t step = 0; step < steps; ++step) {
+            map.beat_grid.push_back(beat_event {
+                .sample = segment_step_sample(segment, step),
+                .bar_start = step % segment.time_sig == 0,
+            });
+        }
+    }
+}
+
+uint32_t Tempo::segment_whole_steps(const beat_segment& segment, uint32_t sample)
 {
-    double step_position = static_cast<double>(track_position) / _stable_samples_per_beat;
+    // Same arithmetic as the position queries, so beats land on the exact
+    // samples at which they report a new step
+    double segment_sample = static_cast<double>(sample - segment.start_sample);
+    double step_position = segment_sample / segment.sample_delta * segment.step_delta;
+
+    return static_cast<uint32_t>(floor(step_position * TICKS_PER_STEP)) / TICKS_PER_STEP;
+}
+
+uint32_t Tempo::segment_step_sample(const beat_segment& segment, uint32_t step)
+{
+    // Close guess first, then settle on the first sample of the step
+    double offset = ceil(step * segment.sample_delta / segment.step_delta);
+    uint32_t sample = segment.start_sample + static_cast<uint32_t>(offset);
+
+    while (sample > segment.start_sample && segment_whole_steps(segment, sample - 1) >= step) {
+        --sample;
+    }
+
+    while (segment_whole_steps(segment, sample) < step) {
+        ++sample;
+    }
+
+    return sample;
+}
+
+song_position Tempo::stable_current_position(const tempo_map& map, uint32_t track_position)
+{
+    double step_position = static_cast<double>(track_position) / map.stable_samples_per_beat;
     uint32_t whole_ticks = static_cast<uint32_t>(floor(step_position * TICKS_PER_STEP));
     uint32_t whole_steps = whole_ticks / TICKS_PER_STEP;
-    uint32_t whole_bars = whole_steps / _stable_time_sig;
+    uint32_t whole_bars = whole_steps / map.stable_time_sig;
     
     return song_position {
         .bar = whole_bars + 1,
-        .step = whole_steps % _stable_time_sig + 1,
-        .tick = whole_ticks - whole_bars * _stable_time_sig * TICKS_PER_STEP + 1,
+        .step = whole_steps % map.stable_time_sig + 1,
+        .tick = whole_ticks - whole_bars * map.stable_time_sig * TICKS_PER_STEP + 1,
     };
 }
 
-uint32_t Tempo::stable_bar_sample(uint32_t bar) const
+uint32_t Tempo::stable_bar_sample(const tempo_map& map, uint32_t bar)
 {
     return static_cast<uint32_t>(
-        round(((bar - 1) * _stable_time_sig) * _stable_samples_per_beat));
+        round(((bar - 1) * map.stable_time_sig) * map.stable_samples_per_beat));
 }
 
-size_t Tempo::varying_bpm_binsearch(
-    size_t start, size_t end, uint32_t track_position) const
+size_t Tempo::varying_bpm_binsearch(const tempo_map& map,
+    size_t start, size_t end, uint32_t track_position)
 {
     while (end - start > 1) {
         size_t center = (start + end) >> 1;
 
-        if (track_position < _varying_bpm[center].sample) {
+        if (track_position < map.varying_bpm[center].sample) {
             end = center;
-        } else if (track_position > _varying_bpm[center].sample) {
+        } else if (track_position > map.varying_bpm[center].sample) {
             start = center;
         } else {
             return center;
@@ -152,66 +309,71 @@ size_t Tempo::varying_bpm_binsearch(
     return start;
 }
 
-size_t Tempo::varying_find_segment_index(uint32_t track_position) const
+size_t Tempo::varying_find_segment_index(const tempo_map& map, uint32_t track_position)
 {
-    size_t segment_count = _varying_bpm.size();
+    size_t segment_count = map.varying_bpm.size();
 
     // Start of the track
-    if (track_position < _varying_bpm.front().sample) {
-        _last_varying_segment = 0;
+    if (track_position < map.varying_bpm.front().sample) {
+        map.last_varying_segment.store(0, std::memory_order_relaxed);
         return 0;
     }
 
     // End of the track
-    if (track_position >= _varying_bpm.back().sample) {
-        _last_varying_segment = segment_count - 1;
+    if (track_position >= map.varying_bpm.back().sample) {
+        map.last_varying_segment.store(segment_count - 1, std::memory_order_relaxed);
         return segment_count - 1;
     }
 
-    // Last search result (in case of sequential queries)
-    if (_last_varying_segment > 0 && _last_varying_segment < segment_count) {
-        if (track_position >= _varying_bpm[_last_varying_segment - 1].sample 
-            && track_position < _varying_bpm[_last_varying_segment].sample) {
+    // Last search result (in case of sequential queries). It's only a hint,
+    // so concurrent readers overwriting each other's result is harmless
+    size_t last_segment = map.last_varying_segment.load(std::memory_order_relaxed);
+    if (last_segment > 0 && last_segment < segment_count) {
+        if (track_position >= map.varying_bpm[last_segment - 1].sample 
+            && track_position < map.varying_bpm[last_segment].sample) {
             
-            return _last_varying_segment;
+            return last_segment;
         }
     }
 
     // If all pre-checks failed, perform bin-search
-    return varying_bpm_binsearch(0, _varying_bpm.size(), track_position) + 1;
+    size_t segment = varying_bpm_binsearch(map, 0, map.varying_bpm.size(), track_position) + 1;
+    map.last_varying_segment.store(segment, std::memory_order_relaxed);
+
+    return segment;
 }
 
-double Tempo::varying_current_bpm(uint32_t track_position) const
+double Tempo::varying_current_bpm(const tempo_map& map, uint32_t track_position)
 {
-    size_t index = varying_find_segment_index(track_position);
+    size_t index = varying_find_segment_index(map, track_position);
 
     if (index == 0) {
         return 0.;
     }
 
-    uint32_t sample_delta = _varying_bpm[index].sample - _varying_bpm[index - 1].sample;
-    uint32_t bar_delta = _varying_bpm[index].bar - _varying_bpm[index - 1].bar;
-    uint32_t step_delta = bar_delta * _varying_bpm[index - 1].time_signature_numerator;
+    uint32_t sample_delta = map.varying_bpm[index].sample - map.varying_bpm[index - 1].sample;
+    uint32_t bar_delta = map.varying_bpm[index].bar - map.varying_bpm[index - 1].bar;
+    uint32_t step_delta = bar_delta * map.varying_bpm[index - 1].time_signature_numerator;
 
     double steps_per_sample = static_cast<double>(step_delta) / static_cast<double>(sample_delta);
 
     return steps_per_sample * AUDIO_SAMPLE_RATE * 60;
 }
 
-uint32_t Tempo::varying_current_time_signature(uint32_t track_position) const
+uint32_t Tempo::varying_current_time_signature(const tempo_map& map, uint32_t track_position)
 {
-    size_t index = varying_find_segment_index(track_position);
+    size_t index = varying_find_segment_index(map, track_position);
 
     if (index == 0) {
         return 0.;
     }
     
-    return _varying_bpm[index - 1].time_signature_numerator;
+    return map.varying_bpm[index - 1].time_signature_numerator;
 }
 
-song_position Tempo::varying_current_position(uint32_t track_position) const
+song_position Tempo::varying_current_position(const tempo_map& map, uint32_t track_position)
 {
-    size_t index = varying_find_segment_index(track_position);
+    size_t index = varying_find_segment_index(map, track_position);
 
     if (index == 0) {
         return song_position {
@@ -221,12 +383,12 @@ song_position Tempo::varying_current_position(uint32_t track_position) const
         };
     }
 
-    uint32_t sample_delta = _varying_bpm[index].sample - _varying_bpm[index - 1].sample;
-    uint32_t bar_delta = _varying_bpm[index].bar - _varying_bpm[index - 1].bar;
-    uint32_t time_sig = _varying_bpm[index - 1].time_signature_numerator;
+    uint32_t sample_delta = map.varying_bpm[index].sample - map.varying_bpm[index - 1].sample;
+    uint32_t bar_delta = map.varying_bpm[index].bar - map.varying_bpm[index - 1].bar;
+    uint32_t time_sig = map.varying_bpm[index - 1].time_signature_numerator;
     uint32_t step_delta = bar_delta * time_sig;
 
-    double segment_sample = static_cast<double>(track_position - _varying_bpm[index - 1].sample);
+    double segment_sample = static_cast<double>(track_position - map.varying_bpm[index - 1].sample);
     double step_position_in_segment = segment_sample / sample_delta * step_delta;
 
     uint32_t whole_ticks = static_cast<uint32_t>(floor(step_position_in_segment * TICKS_PER_STEP));
@@ -234,25 +396,27 @@ song_position Tempo::varying_current_position(uint32_t track_position) const
     uint32_t whole_bars = whole_steps / time_sig;
 
     return song_position {
-        .bar = _varying_bpm[index - 1].bar + whole_bars,
+        .bar = map.varying_bpm[index - 1].bar + whole_bars,
         .step = whole_steps % time_sig + 1,
         .tick = whole_ticks - whole_bars * time_sig * TICKS_PER_STEP + 1,
     };
 }
 
-uint32_t Tempo::varying_bar_sample(uint32_t bar) const
+uint32_t Tempo::varying_bar_sample(const tempo_map& map, uint32_t bar)
 {
-    for (auto it = _varying_bpm.rbegin(); it != _varying_bpm.rend(); ++it) {
+    for (auto it = map.varying_bpm.rbegin(); it != map.varying_bpm.rend(); ++it) {
         if (it->bar > bar) {
             continue;
         }
 
         auto it_next = it;
 
-        if (it == _varying_bpm.rbegin()) {
-            --it;
+        // `it` is the segment start and `it_next` its end. Past the last
+        // tag, the last segment is extrapolated
+        if (it == map.varying_bpm.rbegin()) {
+            ++it;
         } else {
-            ++it_next;
+            --it_next;
         }
 
         double sample_delta = it_next->sample - it->sample;
@@ -1,7 +1,6 @@
 #include <utils.h>
 
 #include <cmath>
-#include <emscripten.h>
 
 
 double Utils::decibels_to_gain(double db)
@@ -0,0 +1,99 @@
+#include <vorbis-arena-pool.h>
+
+#include <algorithm>
+#include <cstdio>
+
+
+const size_t VorbisArenaPool::ARENA_SIZE_MIN = 64 * 1024;
+const size_t VorbisArenaPool::ARENA_SIZE_MAX = 64 * 1024 * 1024;
+const size_t VorbisArenaPool::IDLE_ARENAS_MAX = 8;
+
+VorbisArenaPool::VorbisArenaPool()
+    : _arena_size(ARENA_SIZE_MIN)
+    , _allocated_arena_count(0)
+{
+}
+
+stb_vorbis* VorbisArenaPool::open(std::vector<char>& arena, int& error,
+    const OpenFunction& open_function)
+{
+    if (arena.empty()) {
+        arena = acquire();
+    }
+
+    while (true) {
+        stb_vorbis_alloc alloc = {
+            .alloc_buffer = arena.data(),
+            .alloc_buffer_length_in_bytes = static_cast<int>(arena.size()),
+        };
+
+        stb_vorbis* vorbis = open_function(&alloc, &error);
+        if (vorbis) {
+            // Setup memory grows from the start of the arena, temporary
+            // memory (first for the setup, then for decoding) from its end.
+            // The setup temporary memory is only a lower bound, hence the
+            // rounding up, but never beyond an arena that was large enough.
+            stb_vorbis_info info = stb_vorbis_get_info(vorbis);
+            size_t required = info.setup_memory_required
+                + std::max(info.setup_temp_memory_required, info.temp_memory_required);
+            required = (required / ARENA_SIZE_MIN + 1) * ARENA_SIZE_MIN;
+
+            std::lock_guard lock(_mutex);
+            _arena_size = std::max(_arena_size, std::min(required, arena.size()));
+            return vorbis;
+        }
+
+        if (error != VORBIS_outofmem || arena.size() >= ARENA_SIZE_MAX) {
+            return nullptr;
+        }
+
+        grow(2 * arena.size());
+        arena = acquire();
+    }
+}
+
+void VorbisArenaPool::release(std::vector<char> arena)
+{
+    std::lock_guard lock(_mutex);
+
+    // Decoders wouldn't fit in arenas smaller than the current size
+    if (arena.size() >= _arena_size && _idle_arenas.size() < IDLE_ARENAS_MAX) {
+        _idle_arenas.push_back(std::move(arena));
+    }
+}
+
+uint32_t VorbisArenaPool::allocated_arena_count() const
+{
+    std::lock_guard lock(_mutex);
+    return _allocated_arena_count;
+}
+
+void VorbisArenaPool::grow(size_t arena_size)
+{
+    std::lock_guard lock(_mutex);
+
+    _arena_size = std::max(_arena_size, std::min(arena_size, ARENA_SIZE_MAX));
+    std::erase_if(_idle_arenas,
+        [&](const std::vector<char>& arena) { return arena.size() < _arena_size; });
+}
+
+std::vector<char> VorbisArenaPool::acquire()
+{
+    std::unique_lock lock(_mutex);
+
+    size_t size = _arena_size;
+    auto it = std::find_if(_idle_arenas.begin(), _idle_arenas.end(),
+        [&](const std::vector<char>& arena) { return arena.size() >= size; });
+
+    if (it != _idle_arenas.end()) {
+        std::vector<char> arena = std::move(*it);
+        _idle_arenas.erase(it);
+        return arena;
+    }
+
+    uint32_t count = ++_allocated_arena_count;
+    lock.unlock();
+
+    printf("[VorbisArenaPool] Allocating decoder arena #%u, %zu KiB\n", count, size / 1024);
+    return std::vector<char>(size);
+}
@@ -0,0 +1,103 @@
+#include <vorbis-push-decoder.h>
+
+#include <stb_vorbis.h>
+#include <vorbis-arena-pool.h>
+
+#include <algorithm>
+#include <cmath>
+
+
+VorbisPushDecoder::VorbisPushDecoder(int16_t* output, uint32_t frames,
+    std::shared_ptr<VorbisArenaPool> arenas)
+    : _arenas(std::move(arenas))
+    , _vorbis(nullptr)
+    , _output(output)
+    , _capacity(frames)
+    , _decoded(0)
+{
+}
+
+VorbisPushDecoder::~VorbisPushDecoder()
+{
+    if (_vorbis) {
+        stb_vorbis_close(_vorbis);
+    }
+
+    if (!_arena.empty()) {
+        _arenas->release(std::move(_arena));
+    }
+}
+
+bool VorbisPushDecoder::feed(const char* data, size_t size)
+{
+    _pending.append(data, size);
+    size_t consumed = 0;
+
+    while (consumed < _pending.size()) {
+        const unsigned char* block = reinterpret_cast<const unsigned char*>(_pending.data()) + consumed;
+        int block_size = _pending.size() - consumed;
+
+        if (_vorbis == nullptr) {
+            int used = 0;
+            int vorbis_error = 0;
+            _vorbis = _arenas->open(_arena, vorbis_error, [&](const stb_vorbis_alloc* alloc, int* error) {
+                return stb_vorbis_open_pushdata(block, block_size, &used, error, alloc);
+            });
+
+            if (_vorbis == nullptr) {
+                // Headers aren't complete yet, they get parsed again from
+                // the start once more data arrives
+                if (vorbis_error == VORBIS_need_more_data) break;
+                return false;
+            }
+
+            consumed += used;
+            continue;
+        }
+
+        int channel_count = 0;
+        int frames = 0;
+        float** channels = nullptr;
+        int used = stb_vorbis_decode_frame_pushdata(
+            _vorbis, block, block_size, &channel_count, &channels, &frames);
+
+        if (used == 0 && frames == 0) {
+            // Needs more data
+            break;
+        }
+
+        consumed += used;
+        if (frames > 0) {
+            write_frames(channels, channel_count, frames);
+        }
+    }
+
+    _pending.erase(0, consumed);
+    return true;
+}
+
+uint32_t VorbisPushDecoder::decoded_frames() const
+{
+    return _decoded;
+}
+
+void VorbisPushDecoder::write_frames(float** channels, int channel_count, int frames)
+{
+    uint32_t count = std::min<uint32_t>(frames, _capacity - _decoded);
+    const float* left = channels[0];
+    const float* right = channels[channel_count > 1 ? 1 : 0];
+    int16_t* out = _output + 2 * _decoded;
+
+    // Same rounding and clipping as stb_vorbis' own short conversion
+    auto to_short = [](float sample) {
+        long value = std::lrint(sample * 32768.f);
+        return static_cast<int16_t>(std::clamp<long>(value, -32768, 32767));
+    };
+
+    for (uint32_t i = 0; i < count; ++i) {
+        out[2 * i] = to_short(left[i]);
+        out[2 * i + 1] = to_short(right[i]);
+    }
+
+    _decoded += count;
+}
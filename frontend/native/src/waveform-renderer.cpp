@@ -1,12 +1,14 @@
 #include <waveform-renderer.h>
 
-#include <lodepng.h>
+#include <peak-pyramid.h>
+#include <worker-pool.h>
+
 #include <algorithm>
+#include <cmath>
+#include <cstdlib>
 #include <iostream>
 
-#define SAMPLE_MAX 32767
-#define SAMPLE_MIN -32768
-
+const int WaveformRenderer::PARALLEL_COLUMNS_PER_TASK = 256;
 
 WaveformRenderer::WaveformRenderer(SilenceDetector& detector)
     : WaveformRenderer(4096, 128,detector) {}
@@ -22,7 +24,13 @@ WaveformRenderer::WaveformRenderer(int width, int height,SilenceDetector& detect
     , _silence_threshold(400)
     , _silence_min_length(100000)
     , _silence_detector(detector)
+    , _pool(nullptr)
+{
+}
+
+void WaveformRenderer::set_worker_pool(WorkerPool* pool)
 {
+    _pool = pool;
 }
 
 void WaveformRenderer::set_silence_alpha(uint8_t alpha)
@@ -83,81 +91,164 @@ uint32_t WaveformRenderer::silence_min_length() const
     return _silence_min_length;
 }
 
-std::vector<uint8_t> WaveformRenderer::render_waveform_to_png(
-    int32_t offset, uint32_t total_length, const int16_t* samples, uint32_t num_samples)
+auto WaveformRenderer::compute_column_peaks(
+    int32_t offset, uint32_t total_length, const PeakPyramid& peaks) -> ColumnPeaks
 {
-    auto image = std::make_unique<pixel[]>(_output_width * _output_height);
-    for (int i = 0; i < _output_width * _output_height; ++i) {
-        image[i].red = image[i].green = image[i].blue = image[i].alpha = 0;
-    }
-
-    process_waveform(image.get(), offset, total_length, samples, num_samples);
-    process_silence(image.get(), offset, total_length, samples, num_samples);
+    ColumnPeaks columns(_output_width);
+    for_each_column_range([&](int first_column, int last_column) {
+        for (int x = first_column; x < last_column; ++x) {
+            columns[x] = get_column_peaks_at(x, total_length, offset, peaks);
+        }
+    });
 
-    std::vector<uint8_t> png;
-    lodepng::encode(png, reinterpret_cast<uint8_t*>(image.get()), _output_width, _output_height);
-    return png;
+    return columns;
 }
 
-void WaveformRenderer::process_waveform(pixel* image, int32_t offset, 
-    uint32_t total_length, const int16_t* samples, uint32_t num_samples)
+auto WaveformRenderer::shift_column_peaks(const ColumnPeaks& columns, int32_t columns_offset,
+    int32_t offset, uint32_t total_length, const PeakPyramid& peaks) -> ColumnPeaks
 {
-    uint32_t start_sample = 0;
+    if (static_cast<int>(columns.size()) != _output_width || total_length == 0) {
+        return compute_column_peaks(offset, total_length, peaks);
+    }
+
+    // A pure offset change moves the columns by the delta rounded to whole
+    // columns, only the ones uncovered at the edge need to be computed.
+    // Columns end up at most half a column away from an exact render.
+    double delta = static_cast<double>(offset) - columns_offset;
+    long shift = std::lround(delta * _output_width / total_length);
+    if (std::labs(shift) >= _output_width) {
+        return compute_column_peaks(offset, total_length, peaks);
+    }
 
+    ColumnPeaks shifted(_output_width);
     for (int x = 0; x < _output_width; ++x) {
-        uint32_t end_sample = get_column_end_sample(x, total_length);
-        auto [hi_peak, low_peak] = get_column_peaks(
-            start_sample, end_sample, offset, samples, num_samples);
-
-        int hi_peak_px = peak_to_pixel(hi_peak);
-        int low_peak_px = peak_to_pixel(low_peak);
-
-        // Draw waveform
-        for (int y = hi_peak_px; y <= low_peak_px; ++y) {
-            auto& pixel = image[y * _output_width + x];
-            pixel.red = _color_red;
-            pixel.green = _color_green;
-            pixel.blue = _color_blue;
-            pixel.alpha = _color_alpha;
+        long source = x - shift;
+        if (source >= 0 && source < _output_width) {
+            shifted[x] = columns[source];
+        } else {
+            shifted[x] = get_column_peaks_at(x, total_length, offset, peaks);
         }
-
-        start_sample = end_sample;
     }
+
+    return shifted;
+}
+
+std::vector<uint8_t> WaveformRenderer::render_waveform(
+    int32_t offset, uint32_t total_length, const PeakPyramid& peaks, uint32_t num_samples)
+{
+    return render_waveform(offset, total_length, 
+        compute_column_peaks(offset, total_length, peaks), num_samples);
+}
+
+std::vector<uint8_t> WaveformRenderer::render_waveform(
+    int32_t offset, uint32_t total_length, const ColumnPeaks& columns, uint32_t num_samples)
+{
+    // Zero-initialized, so every pixel starts fully transparent
+    std::vector<uint8_t> image(_output_width * _output_height * sizeof(pixel));
+    pixel* pixels = reinterpret_cast<pixel*>(image.data());
+
+    process_waveform(pixels, columns);
+    process_silence(pixels, offset, total_length, num_samples);
+
+    return image;
+}
+
+void WaveformRenderer::process_waveform(pixel* image, const ColumnPeaks& columns)
+{
+    for_each_column_range([&](int first_column, int last_column) {
+        for (int x = first_column; x < last_column; ++x) {
+            auto [hi_peak, low_peak] = columns[x];
+
+            int hi_peak_px = peak_to_pixel(hi_peak);
+            int low_peak_px = peak_to_pixel(low_peak);
+
+            // Draw waveform
+            for (int y = hi_peak_px; y <= low_peak_px; ++y) {
+                auto& pixel = image[y * _output_width + x];
+                pixel.red = _color_red;
+                pixel.green = _color_green;
+                pixel.blue = _color_blue;
+                pixel.alpha = _color_alpha;
+            }
+        }
+    });
 }
 
 void WaveformRenderer::process_silence(pixel* image, int32_t offset, 
-    int32_t total_length, const int16_t* samples, int32_t num_samples)
+    int32_t total_length, int32_t num_samples)
 {
+    // Finding the silent columns is cheap and sequential,
+    // blending them is what takes time
+    std::vector<uint8_t> silent_columns(_output_width, false);
+
     int current_column = 0;
     if(offset>=0){
-        draw_silence(image,total_length,current_column,0,offset);
+        mark_silence(silent_columns,total_length,current_column,0,offset);
     }
     for (auto&& [start,end] : _silence_detector) {
         if(end + offset >= 0){
-            draw_silence(image, total_length, 
+            mark_silence(silent_columns, total_length, 
                 current_column, std::max(start+offset,0), end+offset);
         }
     }   
     if(total_length> num_samples+offset){
-        draw_silence(image,total_length,current_column,std::max(num_samples+offset,0),total_length);
+        mark_silence(silent_columns,total_length,current_column,std::max(num_samples+offset,0),total_length);
     }
+
+    // Silent columns mostly come in long spans, blend them row by row
+    std::vector<std::pair<int, int>> spans;
+    for (int x = 0; x < _output_width; ++x) {
+        if (!silent_columns[x]) {
+            continue;
+        }
+
+        if (!spans.empty() && spans.back().second == x) {
+            spans.back().second = x + 1;
+        } else {
+            spans.emplace_back(x, x + 1);
+        }
+    }
+
+    if (spans.empty()) {
+        return;
+    }
+
+    silence_blend blend = make_silence_blend();
+
+    for_each_column_range([&](int first_column, int last_column) {
+        for (auto [span_start, span_end] : spans) {
+            span_start = std::max(span_start, first_column);
+            span_end = std::min(span_end, last_column);
+            if (span_start >= span_end) {
+                continue;
+            }
+
+            for (int y = 0; y < _output_height; ++y) {
+                pixel* row = image + y * _output_width;
+                for (int x = span_start; x < span_end; ++x) {
+                    auto& src = row[x];
+                    uint32_t scale = blend.color_scale[src.alpha];
+                    src.red = (src.red * scale) >> 16;
+                    src.green = (src.green * scale) >> 16;
+                    src.blue = (src.blue * scale) >> 16;
+                    src.alpha = blend.alpha[src.alpha];
+                }
+            }
+        }
+    });
 }
 
-void WaveformRenderer::draw_silence(pixel* image, uint32_t total_length, int& column, 
-    uint32_t silence_start, uint32_t silence_end)
+void WaveformRenderer::mark_silence(std::vector<uint8_t>& silent_columns, 
+    uint32_t total_length, int& column, uint32_t silence_start, uint32_t silence_end)
 {
     uint32_t column_start = column <= 0 ? 0 : get_column_end_sample(column - 1, total_length);
     uint32_t column_end = get_column_end_sample(column, total_length);
 
-    pixel over = { 0, 0, 0, _silence_alpha };
-
     while (column_end < silence_end) {
         if(column >= _output_width)
             break;
         if (silence_start <= column_start) {
-            for (int y = 0; y < _output_height; ++y) {
-                blend_pixel(image[y * _output_width + column], over);
-            }
+            silent_columns[column] = true;
         }
 
         ++column;
@@ -166,41 +257,62 @@ void WaveformRenderer::draw_silence(pixel* image, uint32_t total_length, int& co
     }
 }
 
-void WaveformRenderer::blend_pixel(pixel& src, const pixel& over)
+void WaveformRenderer::for_each_column_range(const std::function<void(int, int)>& function)
+{
+    int task_count = (_output_width + PARALLEL_COLUMNS_PER_TASK - 1) / PARALLEL_COLUMNS_PER_TASK;
+
+    auto task = [&](size_t index) {
+        int first_column = index * PARALLEL_COLUMNS_PER_TASK;
+        function(first_column, std::min(first_column + PARALLEL_COLUMNS_PER_TASK, _output_width));
+    };
+
+    // Another waveform is using the pool, this one is rendered on the calling thread
+    if (!_pool || task_count <= 1 || !_pool->try_run(task_count, task)) {
+        function(0, _output_width);
+    }
+}
+
+WaveformRenderer::silence_blend WaveformRenderer::make_silence_blend() const
 {
     // https://en.wikipedia.org/wiki/Alpha_compositing
-    
-    float over_alpha = over.alpha / 255.f;
-    float src_alpha = src.alpha / 255.f;
-    float alpha = over_alpha + src_alpha * (1.f - over_alpha);
+    //
+    // The overlay is black, so a composited color is just the source color
+    // scaled by src_alpha * (1 - over_alpha) / alpha, and both the scale and
+    // the resulting alpha only depend on the source alpha
+    silence_blend blend;
+    uint32_t over_alpha = _silence_alpha;
+
+    for (uint32_t src_alpha = 0; src_alpha < 256; ++src_alpha) {
+        // Both in units of 1 / (255 * 255)
+        uint32_t src_weight = src_alpha * (255 - over_alpha);
+        uint32_t alpha = over_alpha * 255 + src_weight;
+
+        blend.alpha[src_alpha] = (alpha + 127) / 255;
+        blend.color_scale[src_alpha] = alpha == 0 ? 0
+            : ((static_cast<uint64_t>(src_weight) << 16) + alpha - 1) / alpha;
+    }
 
-    src.alpha = static_cast<uint8_t>(round(alpha * 255.f));
-    src.red = (over.red * over_alpha + src.red * src_alpha * (1.f - over_alpha)) / alpha;
-    src.green = (over.green * over_alpha + src.green * src_alpha * (1.f - over_alpha)) / alpha;
-    src.blue = (over.blue * over_alpha + src.blue * src_alpha * (1.f - over_alpha)) / alpha;
+    return blend;
 }
 
 std::pair<int16_t, int16_t> WaveformRenderer::get_column_peaks(uint32_t start_sample, 
-    uint32_t end_sample, int32_t offset, const int16_t* samples, uint32_t num_samples)
+    uint32_t end_sample, int32_t offset, const PeakPyramid& peaks)
 {
     if (start_sample >= end_sample) {
         return std::make_pair(0, 0);
     }
 
-    int16_t hi_peak = SAMPLE_MIN, low_peak = SAMPLE_MAX;
-    for (uint32_t sample = start_sample; sample < end_sample; ++sample) {
-        int32_t stem_sample = sample - offset;
-        if (stem_sample < 0) continue;
-        if (stem_sample >= static_cast<int32_t>(num_samples)) break;
-
-        int16_t left = samples[2 * stem_sample];
-        int16_t right = samples[2 * stem_sample + 1];
-        
-        hi_peak = std::max({ hi_peak, left, right });
-        low_peak = std::min({ low_peak, left, right });
-    }
+    return peaks.peaks(static_cast<int64_t>(start_sample) - offset, 
+        static_cast<int64_t>(end_sample) - offset);
+}
+
+std::pair<int16_t, int16_t> WaveformRenderer::get_column_peaks_at(int x, 
+    uint32_t total_length, int32_t offset, const PeakPyramid& peaks)
+{
+    uint32_t start_sample = x <= 0 ? 0 : get_column_end_sample(x - 1, total_length);
+    uint32_t end_sample = get_column_end_sample(x, total_length);
 
-    return std::make_pair(hi_peak, low_peak);
+    return get_column_peaks(start_sample, end_sample, offset, peaks);
 }
 
 uint32_t WaveformRenderer::get_column_end_sample(int x, uint32_t total_length) const {
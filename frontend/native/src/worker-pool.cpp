@@ -0,0 +1,104 @@
+#include <worker-pool.h>
+
+#include <cassert>
+
+
+const uint64_t WorkerPool::CURSOR_INDEX_MASK = 0xFFFF;
+const int WorkerPool::CURSOR_COUNT_SHIFT = 16;
+const int WorkerPool::CURSOR_GENERATION_SHIFT = 32;
+
+WorkerPool::WorkerPool(size_t thread_count)
+    : _stopping(false)
+    , _busy(false)
+    , _cursor(0)
+    , _remaining(0)
+    , _context(nullptr)
+    , _function(nullptr)
+{
+    for (size_t i = 0; i < thread_count; ++i) {
+        _threads.emplace_back(&WorkerPool::thread_main, this);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    _stopping = true;
+    _cursor.fetch_add(1ull << CURSOR_GENERATION_SHIFT, std::memory_order_release);
+    _cursor.notify_all();
+
+    for (auto& thread : _threads) {
+        thread.join();
+    }
+}
+
+size_t WorkerPool::thread_count() const
+{
+    return _threads.size();
+}
+
+void WorkerPool::dispatch(size_t task_count, void* context, TaskFunction function)
+{
+    if (task_count == 0) {
+        return;
+    }
+
+    assert(task_count <= CURSOR_INDEX_MASK);
+
+    _context = context;
+    _function = function;
+    _remaining.store(task_count, std::memory_order_relaxed);
+
+    uint64_t generation = (_cursor.load(std::memory_order_relaxed) >> CURSOR_GENERATION_SHIFT) + 1;
+    _cursor.store((generation << CURSOR_GENERATION_SHIFT) | (task_count << CURSOR_COUNT_SHIFT),
+        std::memory_order_release);
+
+    if (!_threads.empty()) {
+        _cursor.notify_all();
+    }
+
+    // The calling thread takes part in the job as well
+    while (run_one_task()) { }
+
+    uint32_t remaining;
+    while ((remaining = _remaining.load(std::memory_order_acquire)) != 0) {
+        _remaining.wait(remaining, std::memory_order_acquire);
+    }
+}
+
+void WorkerPool::thread_main()
+{
+    while (true) {
+        uint64_t cursor = _cursor.load(std::memory_order_acquire);
+        if (_stopping) {
+            return;
+        }
+
+        if (!run_one_task()) {
+            _cursor.wait(cursor, std::memory_order_acquire);
+        }
+    }
+}
+
+bool WorkerPool::run_one_task()
+{
+    uint64_t cursor = _cursor.load(std::memory_order_acquire);
+    uint64_t index;
+
+    do {
+        uint64_t count = (cursor >> CURSOR_COUNT_SHIFT) & CURSOR_INDEX_MASK;
+        index = cursor & CURSOR_INDEX_MASK;
+
+        if (index >= count) {
+            return false;
+        }
+    } while (!_cursor.compare_exchange_weak(cursor, cursor + 1,
+        std::memory_order_acq_rel, std::memory_order_acquire));
+
+    _function(_context, index);
+
+    if (_remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _remaining.notify_all();
+    }
+
+    return true;
+}
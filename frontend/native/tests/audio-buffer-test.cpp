@@ -0,0 +1,152 @@
+#include <audio-buffer.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <thread>
+
+/*
+ * Hammers AudioBuffer from three threads: the producer writes numbered
+ * chunks, the consumer checks every chunk it reads, and a third thread keeps
+ * resetting the buffer. A chunk must never be torn (all of its samples come
+ * from the same write) and never be read twice or out of order. Once the
+ * resets stop, every chunk written afterwards has to arrive.
+ */
+
+namespace {
+
+const int BUFFER_SAMPLES = 1024;
+const auto RESET_PHASE = std::chrono::milliseconds(1500);
+const uint32_t FINAL_CHUNKS = 20000;
+
+// Chunk numbers must stay exact as floats
+const uint32_t CHUNK_NUMBER_MAX = 1 << 24;
+
+void fill_chunk(audio_chunk& chunk, uint32_t number, bool final)
+{
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+        chunk.left_channel[i] = number;
+        chunk.right_channel[i] = final ? 1.f : 0.f;
+    }
+}
+
+} // namespace
+
+int main()
+{
+    AudioBuffer buffer(BUFFER_SAMPLES);
+
+    std::atomic_bool resets_stopped(false);
+    std::atomic_bool producer_done(false);
+    std::atomic<uint32_t> final_written(0);
+    std::atomic<uint32_t> reset_count(0);
+    int errors = 0;
+
+    std::thread producer([&] {
+        std::mt19937 random(1);
+        uint32_t number = 0;
+        uint32_t final_count = 0;
+
+        while (final_count < FINAL_CHUNKS && number < CHUNK_NUMBER_MAX) {
+            // Checked before the slot is acquired, so a final chunk always
+            // carries the epoch of the last reset
+            bool final = resets_stopped.load();
+            ++number;
+
+            if (random() % 4 == 0) {
+                audio_chunk chunk;
+                fill_chunk(chunk, number, final);
+                buffer << chunk;
+            } else {
+                fill_chunk(buffer.acquire_write_slot(), number, final);
+                buffer.commit_write_slot();
+            }
+
+            if (final) {
+                ++final_count;
+            }
+        }
+
+        final_written = final_count;
+        producer_done = true;
+    });
+
+    std::thread consumer([&] {
+        std::mt19937 random(2);
+        uint32_t last_number = 0;
+        uint32_t final_read = 0;
+        audio_chunk copy;
+
+        while (true) {
+            const audio_chunk* chunk = nullptr;
+            bool copied = random() % 4 == 0;
+
+            if (copied) {
+                if (buffer >> copy) chunk = &copy;
+            } else {
+                chunk = buffer.acquire_read_slot();
+            }
+
+            if (chunk == nullptr) {
+                if (producer_done && final_read == final_written) break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            float number = chunk->left_channel[0];
+            float final = chunk->right_channel[0];
+            for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+                if (chunk->left_channel[i] != number || chunk->right_channel[i] != final) {
+                    fprintf(stderr, "Chunk %.0f is torn at sample %d\n", number, i);
+                    ++errors;
+                    break;
+                }
+            }
+
+            if (number <= last_number) {
+                fprintf(stderr, "Chunk %.0f read after chunk %u\n", number, last_number);
+                ++errors;
+            } else if (final_read > 0 && number != last_number + 1) {
+                fprintf(stderr, "Chunks %u to %.0f lost without a reset\n", last_number + 1, number - 1);
+                ++errors;
+            }
+
+            last_number = number;
+            if (final == 1.f) {
+                ++final_read;
+            }
+
+            if (!copied) {
+                buffer.release_read_slot();
+            }
+        }
+
+        if (final_read != FINAL_CHUNKS) {
+            fprintf(stderr, "Got %u of %u chunks written after the last reset\n",
+                final_read, FINAL_CHUNKS);
+            ++errors;
+        }
+    });
+
+    std::thread resetter([&] {
+        std::mt19937 random(3);
+        auto end = std::chrono::steady_clock::now() + RESET_PHASE;
+
+        while (std::chrono::steady_clock::now() < end) {
+            buffer.clear();
+            ++reset_count;
+            std::this_thread::sleep_for(std::chrono::microseconds(random() % 200));
+        }
+
+        resets_stopped = true;
+    });
+
+    resetter.join();
+    producer.join();
+    consumer.join();
+
+    printf("%u resets, %d underflows, %d errors\n",
+        reset_count.load(), buffer.underflow_count(), errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,83 @@
+#include <filter-fir.h>
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+ * Per-sample cost of FIRFilter one sample at a time (operator()) and in
+ * chunk sized blocks (process()), for a few tap counts
+ */
+
+namespace {
+
+const size_t SIGNAL_LENGTH = 1 << 20;
+const size_t CHUNK_SAMPLES = 128;
+const int RUNS = 5;
+
+template <typename Function>
+double best_ns_per_sample(Function function)
+{
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        double per_sample = elapsed.count() / SIGNAL_LENGTH;
+        if (run == 0 || per_sample < best) {
+            best = per_sample;
+        }
+    }
+
+    return best;
+}
+
+template <unsigned long taps>
+void measure(const std::vector<float>& input)
+{
+    std::array<float, taps> coefficients;
+    for (size_t i = 0; i < taps; ++i) {
+        coefficients[i] = input[i] / taps;
+    }
+
+    std::vector<float> output(input.size());
+    FIRFilter<taps> filter(coefficients);
+
+    double single = best_ns_per_sample([&] {
+        for (size_t i = 0; i < input.size(); ++i) {
+            output[i] = filter(input[i]);
+        }
+    });
+    float single_check = output.back();
+
+    double block = best_ns_per_sample([&] {
+        for (size_t i = 0; i < input.size(); i += CHUNK_SAMPLES) {
+            filter.process(&input[i], &output[i], CHUNK_SAMPLES);
+        }
+    });
+
+    printf("%4lu taps   operator() %7.2f ns   process() %7.2f ns   %.1fx   (%g %g)\n",
+        taps, single, block, single / block, single_check, output.back());
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(18);
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    std::vector<float> input(SIGNAL_LENGTH);
+    for (float& sample : input) {
+        sample = distribution(random);
+    }
+
+    measure<16>(input);
+    measure<28>(input);
+    measure<32>(input);
+    measure<64>(input);
+    measure<111>(input);
+    measure<256>(input);
+}
@@ -0,0 +1,103 @@
+#include <filter-fir.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <vector>
+
+/*
+ * Checks FIRFilter against a double precision convolution, one sample at a
+ * time, in blocks of odd sizes, in blocks longer than the internal one and
+ * with both entry points mixed on the same filter.
+ */
+
+namespace {
+
+const size_t SIGNAL_LENGTH = 5000;
+const double TOLERANCE = 1e-5;
+
+template <unsigned long taps>
+std::vector<double> reference(const std::array<float, taps>& coefficients,
+    const std::vector<float>& input)
+{
+    std::vector<double> output(input.size());
+    for (size_t n = 0; n < input.size(); ++n) {
+        double sum = 0;
+        for (size_t j = 0; j < taps && j <= n; ++j) {
+            sum += double(coefficients[j]) * input[n - j];
+        }
+        output[n] = sum;
+    }
+
+    return output;
+}
+
+template <unsigned long taps>
+int check(std::mt19937& random)
+{
+    std::uniform_real_distribution<float> distribution(-1.f, 1.f);
+
+    std::array<float, taps> coefficients;
+    for (float& coefficient : coefficients) {
+        coefficient = distribution(random) / taps;
+    }
+
+    std::vector<float> input(SIGNAL_LENGTH);
+    for (float& sample : input) {
+        sample = distribution(random);
+    }
+
+    std::vector<double> expected = reference(coefficients, input);
+    const size_t block_sizes[] = { 1, 3, 4, 7, 128, 129, 300 };
+    int errors = 0;
+
+    // Block size 0 stands for operator(), and the last pass mixes
+    // operator() with every block size in turn
+    for (int pass = 0; pass <= int(std::size(block_sizes)) + 1; ++pass) {
+        FIRFilter<taps> filter(coefficients);
+        std::vector<float> output(input);
+        size_t position = 0;
+
+        for (int step = 0; position < input.size(); ++step) {
+            size_t block = pass == 0 ? 0
+                : pass <= int(std::size(block_sizes)) ? block_sizes[pass - 1]
+                : step % 2 ? 0 : block_sizes[step / 2 % std::size(block_sizes)];
+            block = std::min(block, input.size() - position);
+
+            if (block == 0) {
+                output[position] = filter(output[position]);
+                ++position;
+            } else {
+                // In place, like the callers do with their chunks
+                filter.process(&output[position], &output[position], block);
+                position += block;
+            }
+        }
+
+        double max_error = 0;
+        for (size_t n = 0; n < input.size(); ++n) {
+            max_error = std::max(max_error, std::abs(output[n] - expected[n]));
+        }
+
+        if (max_error > TOLERANCE) {
+            fprintf(stderr, "%lu taps, pass %d: max error %g\n", taps, pass, max_error);
+            ++errors;
+        }
+    }
+
+    return errors;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(18);
+    int errors = check<1>(random) + check<3>(random) + check<4>(random)
+        + check<28>(random) + check<111>(random) + check<256>(random);
+
+    printf("%d errors\n", errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,81 @@
+#include <limiter.h>
+
+#include "limiter-reference.h"
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+
+/*
+ * Per-quantum cost of the limiter modes with the mixer's settings,
+ * next to the previous decibel implementation
+ */
+
+namespace {
+
+const int QUANTA = 10 * AUDIO_SAMPLE_RATE / AUDIO_CHUNK_SAMPLES;
+const int RUNS = 15;
+
+double measure(const char* name, const std::vector<audio_chunk>& program,
+    const std::function<void(audio_chunk&)>& apply)
+{
+    std::vector<audio_chunk> chunks(program);
+    double best = 0;
+
+    for (int run = 0; run < RUNS; ++run) {
+        chunks = program;
+
+        auto start = std::chrono::steady_clock::now();
+        for (audio_chunk& chunk : chunks) {
+            apply(chunk);
+        }
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+
+        double per_quantum = elapsed.count() / chunks.size();
+        if (run == 0 || per_quantum < best) {
+            best = per_quantum;
+        }
+    }
+
+    printf("%-28s %6.2f us per quantum\n", name, best);
+    return best;
+}
+
+void configure(Limiter& limiter, Limiter::Mode mode, bool stereo_linked)
+{
+    limiter.set_knee_db(1.);
+    limiter.set_threshold_db(-2);
+    limiter.set_attack_ms(5.);
+    limiter.set_release_ms(50.);
+    limiter.set_lookahead_ms(5.);
+    limiter.set_mode(mode);
+    limiter.set_stereo_linked(stereo_linked);
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<audio_chunk> program = reference::make_program(QUANTA);
+
+    reference::Limiter previous(5., 50., 1., -2.);
+    double before = measure("previous (dB, unlinked)", program,
+        [&](audio_chunk& chunk) { previous.apply(chunk); });
+
+    Limiter reactive;
+    configure(reactive, Limiter::Mode::REACTIVE, false);
+    double after = measure("reactive, unlinked", program,
+        [&](audio_chunk& chunk) { reactive.apply(chunk); });
+
+    Limiter reactive_linked;
+    configure(reactive_linked, Limiter::Mode::REACTIVE, true);
+    measure("reactive, linked", program,
+        [&](audio_chunk& chunk) { reactive_linked.apply(chunk); });
+
+    Limiter lookahead;
+    configure(lookahead, Limiter::Mode::LOOKAHEAD, true);
+    measure("lookahead, linked (mixer)", program,
+        [&](audio_chunk& chunk) { lookahead.apply(chunk); });
+
+    printf("Reactive unlinked speedup: %.1fx\n", before / after);
+}
@@ -0,0 +1,122 @@
+#pragma once
+#include <audio-buffer.h>
+#include <utils.h>
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+/*
+ * The limiter as it was before its envelope moved to log2 units: a reactive,
+ * unlinked envelope in decibels with the exact log10 and pow per sample.
+ * Kept as the golden reference for limiter-test and limiter-bench.
+ */
+
+namespace reference {
+
+class Limiter {
+public:
+    Limiter(double attack_ms, double release_ms, double knee_db, double threshold_db)
+        : _attack_coeff(milliseconds_to_ewma_coeff(attack_ms))
+        , _release_coeff(milliseconds_to_ewma_coeff(release_ms))
+        , _knee(knee_db)
+        , _threshold(threshold_db)
+    {
+    }
+
+    double reduction_db() const
+    {
+        return _reduction_db;
+    }
+
+    void apply(audio_chunk& chunk)
+    {
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            process_sample(chunk.left_channel[i], _current_peak_l, _current_reduction_l);
+            process_sample(chunk.right_channel[i], _current_peak_r, _current_reduction_r);
+        }
+
+        _reduction_db = std::min(_current_reduction_l, _current_reduction_r);
+    }
+
+private:
+    static constexpr double PEAK_DESCENT_RATE = 0.999;
+
+    double _attack_coeff, _release_coeff;
+    double _knee, _threshold;
+    double _reduction_db = 0.;
+    double _current_peak_l = 0., _current_peak_r = 0.;
+    double _current_reduction_l = 0., _current_reduction_r = 0.;
+
+    void process_sample(float& sample, double& peak, double& reduction)
+    {
+        peak *= PEAK_DESCENT_RATE;
+        peak = std::max<double>({ peak, std::abs(sample) });
+
+        double peak_db = Utils::gain_to_decibels(peak);
+        double target_db = calculate_target_db(peak_db);
+        double target_gain_db = target_db - peak_db;
+
+        if (reduction < target_gain_db) {
+            reduction += _release_coeff * (target_gain_db - reduction);
+        } else if (reduction > target_gain_db) {
+            reduction += _attack_coeff * (target_gain_db - reduction);
+        }
+
+        double sample_gain = Utils::decibels_to_gain(reduction);
+        sample *= sample_gain;
+    }
+
+    double calculate_target_db(double input_db) const
+    {
+        if (input_db < _threshold - _knee / 2.) return input_db;
+        if (input_db > _threshold + _knee / 2.) return _threshold;
+        return input_db - std::pow(input_db - _threshold + _knee / 2., 2.) / (2. * _knee);
+    }
+
+    static double milliseconds_to_ewma_coeff(double time_ms)
+    {
+        if (time_ms < 0.001) return 0;
+        return 1 - std::exp(-2. * M_PI * 100.0 / AUDIO_SAMPLE_RATE / time_ms);
+    }
+};
+
+/*
+ * Program material for the comparisons, driven up to 12 dB over full scale:
+ * tones at changing levels, noise bursts over a quiet bed and a stretch of
+ * digital silence. The channels differ, so unlinked envelopes diverge.
+ */
+inline std::vector<audio_chunk> make_program(int quanta)
+{
+    const double levels[] = { 0.25, 1., 4., 0.5, 2., 3. };
+    std::mt19937 random(21);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+    std::vector<audio_chunk> program(quanta);
+
+    for (int q = 0; q < quanta; ++q) {
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            int n = q * AUDIO_CHUNK_SAMPLES + i;
+            double t = double(n) / AUDIO_SAMPLE_RATE;
+            int section = n / AUDIO_SAMPLE_RATE % 8;
+            float left = 0.f, right = 0.f;
+
+            if (section < 6) {
+                double level = levels[section];
+                left = level * (0.7 * std::sin(2 * M_PI * 220. * t) + 0.3 * std::sin(2 * M_PI * 3100. * t));
+                right = 0.7 * level * std::sin(2 * M_PI * 330. * t + 1.);
+            } else if (section == 6) {
+                bool burst = n % (AUDIO_SAMPLE_RATE / 3) < AUDIO_SAMPLE_RATE / 20;
+                left = (burst ? 3.f : 0.02f) * noise(random);
+                right = (burst ? 1.5f : 0.01f) * noise(random);
+            }
+
+            program[q].left_channel[i] = left;
+            program[q].right_channel[i] = right;
+        }
+    }
+
+    return program;
+}
+
+} // namespace reference
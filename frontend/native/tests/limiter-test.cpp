@@ -0,0 +1,203 @@
+#include <limiter.h>
+
+#include "limiter-reference.h"
+
+#include <cstdio>
+
+/*
+ * Golden test of the log2 envelope and its fast log2/exp2 approximations
+ * against the previous decibel implementation, in the reactive unlinked
+ * mode that both have. The applied gain of every sample and the reported
+ * reduction must stay within TOLERANCE_DB.
+ *
+ * The lookahead mode has no reference, it's checked to keep every output
+ * sample under the threshold, up to the longest lookahead. The reactive
+ * mode is checked to never exceed full scale.
+ */
+
+namespace {
+
+const int QUANTA = 20 * AUDIO_SAMPLE_RATE / AUDIO_CHUNK_SAMPLES;
+const double TOLERANCE_DB = 1e-3;
+
+struct settings {
+    double attack_ms, release_ms, knee_db, threshold_db;
+};
+
+double gain_db(float output, float input)
+{
+    return Utils::gain_to_decibels(std::abs(output / input));
+}
+
+int check(const settings& s, const std::vector<audio_chunk>& program)
+{
+    reference::Limiter expected_limiter(s.attack_ms, s.release_ms, s.knee_db, s.threshold_db);
+
+    Limiter limiter;
+    limiter.set_mode(Limiter::Mode::REACTIVE);
+    limiter.set_stereo_linked(false);
+    limiter.set_attack_ms(s.attack_ms);
+    limiter.set_release_ms(s.release_ms);
+    limiter.set_knee_db(s.knee_db);
+    limiter.set_threshold_db(s.threshold_db);
+
+    double max_gain_error = 0, max_reduction_error = 0, max_reduction = 0;
+
+    for (const audio_chunk& input : program) {
+        audio_chunk expected = input, output = input;
+        expected_limiter.apply(expected);
+        limiter.apply(output);
+
+        // The worklet used to hard clip the previous limiter's output
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            expected.left_channel[i] = std::clamp(expected.left_channel[i], -1.f, 1.f);
+            expected.right_channel[i] = std::clamp(expected.right_channel[i], -1.f, 1.f);
+        }
+
+        const float* channels[][3] = {
+            { input.left_channel, expected.left_channel, output.left_channel },
+            { input.right_channel, expected.right_channel, output.right_channel },
+        };
+
+        for (auto [in, expected_out, out] : channels) {
+            for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+                // The gain of a silent sample can't be measured
+                if (std::abs(in[i]) < 1e-6f) {
+                    continue;
+                }
+
+                double error = std::abs(gain_db(out[i], in[i]) - gain_db(expected_out[i], in[i]));
+                max_gain_error = std::max(max_gain_error, error);
+            }
+        }
+
+        max_reduction_error = std::max(max_reduction_error,
+            std::abs(limiter.reduction_db() - expected_limiter.reduction_db()));
+        max_reduction = std::min(max_reduction, expected_limiter.reduction_db());
+    }
+
+    bool passed = max_gain_error <= TOLERANCE_DB && max_reduction_error <= TOLERANCE_DB;
+    printf("attack %g ms, release %g ms, knee %g dB, threshold %g dB: up to %.1f dB of "
+        "reduction, max gain error %.2e dB, max reduction error %.2e dB%s\n",
+        s.attack_ms, s.release_ms, s.knee_db, s.threshold_db, -max_reduction,
+        max_gain_error, max_reduction_error, passed ? "" : " FAILED");
+
+    return passed ? 0 : 1;
+}
+
+/*
+ * Loud bursts that fade out by 26 dB over a few lookahead windows. Every
+ * sample needs less reduction than the previous one, which is the longest
+ * the window minimum queue gets.
+ */
+std::vector<audio_chunk> make_decays(int quanta)
+{
+    std::vector<audio_chunk> decays(quanta);
+    for (int q = 0; q < quanta; ++q) {
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            int n = (q * AUDIO_CHUNK_SAMPLES + i) % 5000;
+            float sample = n < 2000 ? 16.f - 0.0076f * n : 0.f;
+            decays[q].left_channel[i] = sample;
+            decays[q].right_channel[i] = -0.5f * sample;
+        }
+    }
+
+    return decays;
+}
+
+int check_lookahead(double lookahead_ms, double release_ms, bool stereo_linked,
+    const std::vector<audio_chunk>& program)
+{
+    const double threshold_db = -2.;
+
+    Limiter limiter;
+    limiter.set_mode(Limiter::Mode::LOOKAHEAD);
+    limiter.set_lookahead_ms(lookahead_ms);
+    limiter.set_stereo_linked(stereo_linked);
+    limiter.set_knee_db(1.);
+    limiter.set_threshold_db(threshold_db);
+    limiter.set_release_ms(release_ms);
+
+    float max_output = 0.f;
+    for (audio_chunk output : program) {
+        limiter.apply(output);
+
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            max_output = std::max({ max_output,
+                std::abs(output.left_channel[i]), std::abs(output.right_channel[i]) });
+        }
+    }
+
+    double overshoot = Utils::gain_to_decibels(max_output) - threshold_db;
+    bool passed = overshoot <= TOLERANCE_DB;
+    printf("lookahead %g ms, release %g ms, %s: max output %+.4f dB over the threshold%s\n",
+        lookahead_ms, release_ms, stereo_linked ? "linked" : "unlinked", overshoot,
+        passed ? "" : " FAILED");
+
+    return passed ? 0 : 1;
+}
+
+int check_reactive_clip(bool stereo_linked, const std::vector<audio_chunk>& program)
+{
+    Limiter limiter;
+    limiter.set_mode(Limiter::Mode::REACTIVE);
+    limiter.set_stereo_linked(stereo_linked);
+    limiter.set_knee_db(1.);
+    limiter.set_threshold_db(-2.);
+    limiter.set_attack_ms(5.);
+    limiter.set_release_ms(50.);
+
+    float max_output = 0.f;
+    for (audio_chunk output : program) {
+        limiter.apply(output);
+
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            max_output = std::max({ max_output,
+                std::abs(output.left_channel[i]), std::abs(output.right_channel[i]) });
+        }
+    }
+
+    bool passed = max_output <= 1.f;
+    printf("reactive, %s: max output %.4f%s\n", stereo_linked ? "linked" : "unlinked",
+        max_output, passed ? "" : " FAILED");
+
+    return passed ? 0 : 1;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<audio_chunk> program = reference::make_program(QUANTA);
+
+    // The mixer's settings first
+    const settings cases[] = {
+        { 5., 50., 1., -2. },
+        { 1., 200., 6., -6. },
+        { 20., 10., 0.5, -1. },
+    };
+
+    int errors = 0;
+    for (const settings& s : cases) {
+        errors += check(s, program);
+    }
+
+    std::vector<audio_chunk> lookahead_program = make_decays(QUANTA / 4);
+    lookahead_program.insert(lookahead_program.end(), program.begin(), program.end());
+
+    // The mixer's lookahead, then the longest one. A fast release lets
+    // the gain follow the window minimum closely, so a wrong minimum shows.
+    for (double lookahead_ms : { 5., 20. }) {
+        for (double release_ms : { 50., 1. }) {
+            for (bool stereo_linked : { true, false }) {
+                errors += check_lookahead(lookahead_ms, release_ms, stereo_linked, lookahead_program);
+            }
+        }
+    }
+
+    for (bool stereo_linked : { true, false }) {
+        errors += check_reactive_clip(stereo_linked, lookahead_program);
+    }
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,169 @@
+#include <audio-buffer.h>
+#include <mix-kernel.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+ * Per-quantum cost of mixing 32 int16 stereo stems into the float bus. The
+ * baseline is the per-sample loop with bounds checks that render_stem used
+ * before the SIMD kernel. Also checks that the kernel matches the scalar
+ * version bit for bit.
+ *
+ * Short stems stay in the cache and show the cost of the kernel itself.
+ * With long stems every quantum streams 16 KiB of fresh samples from
+ * memory, which is what the mixer sees during playback.
+ */
+
+namespace {
+
+const int STEM_COUNT = 32;
+const int STEM_LENGTHS[] = { 44100 / 4, 44100 * 10 };
+const int QUANTA = 20000;
+const int RUNS = 5;
+
+struct stem {
+    std::vector<int16_t> data;
+    int length;
+    int offset;
+    float gain_l;
+    float gain_r;
+};
+
+__attribute__((noinline))
+void mix_bounds_checked(const stem& source, int stem_sample, audio_chunk& chunk)
+{
+    for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i, ++stem_sample) {
+        if (stem_sample < 0 || stem_sample >= source.length) {
+            continue;
+        }
+
+        chunk.left_channel[i] += source.data[2 * stem_sample] * source.gain_l;
+        chunk.right_channel[i] += source.data[2 * stem_sample + 1] * source.gain_r;
+    }
+}
+
+template<typename mix_function>
+void mix_kernel(const stem& source, int stem_sample, audio_chunk& chunk, mix_function mix)
+{
+    int first_frame = std::max(0, -stem_sample);
+    int last_frame = std::min(AUDIO_CHUNK_SAMPLES, source.length - stem_sample);
+    if (first_frame >= last_frame) {
+        return;
+    }
+
+    mix(source.data.data() + 2 * (stem_sample + first_frame), last_frame - first_frame,
+        source.gain_l, source.gain_r,
+        chunk.left_channel + first_frame, chunk.right_channel + first_frame);
+}
+
+template<typename render_function>
+void render(const std::vector<stem>& stems, int quantum, audio_chunk& chunk, render_function render)
+{
+    std::fill_n(chunk.left_channel, AUDIO_CHUNK_SAMPLES, 0.f);
+    std::fill_n(chunk.right_channel, AUDIO_CHUNK_SAMPLES, 0.f);
+
+    int position = (quantum * AUDIO_CHUNK_SAMPLES) % stems[0].length;
+    for (const stem& source : stems) {
+        render(source, position - source.offset, chunk);
+    }
+}
+
+template<typename render_function>
+double measure(const char* name, const std::vector<stem>& stems, render_function render_stem)
+{
+    audio_chunk chunk;
+    double best = 0;
+
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+
+        for (int quantum = 0; quantum < QUANTA; ++quantum) {
+            render(stems, quantum, chunk, render_stem);
+        }
+
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    double per_quantum = best / QUANTA;
+    printf("%-16s %6.3f us per quantum (%d stems)\n", name, per_quantum, STEM_COUNT);
+    return per_quantum;
+}
+
+template<typename render_function>
+bool matches_bounds_checked(const std::vector<stem>& stems, render_function render_stem)
+{
+    audio_chunk expected, actual;
+
+    for (int quantum = 0; quantum < QUANTA; ++quantum) {
+        render(stems, quantum, expected, mix_bounds_checked);
+        render(stems, quantum, actual, render_stem);
+
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            if (expected.left_channel[i] != actual.left_channel[i]
+                || expected.right_channel[i] != actual.right_channel[i]) {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool run(int stem_length, std::mt19937& random)
+{
+    std::vector<stem> stems(STEM_COUNT);
+
+    // Offsets aren't multiples of the quantum, so most stems start and
+    // end in the middle of one
+    for (stem& source : stems) {
+        source.data.resize(2 * stem_length);
+        for (int16_t& sample : source.data) {
+            sample = int16_t(random());
+        }
+        source.length = stem_length;
+        source.offset = random() % (stem_length / 2) - stem_length / 4;
+        source.gain_l = (random() % 1000) / 1000.f / 32768;
+        source.gain_r = (random() % 1000) / 1000.f / 32768;
+    }
+
+    printf("%d stems of %.2f s\n", STEM_COUNT, stem_length / 44100.0);
+
+    auto scalar_kernel = [](const stem& source, int stem_sample, audio_chunk& chunk) {
+        mix_kernel(source, stem_sample, chunk, MixKernel::mix_stereo_scalar);
+    };
+    auto simd_kernel = [](const stem& source, int stem_sample, audio_chunk& chunk) {
+        mix_kernel(source, stem_sample, chunk, MixKernel::mix_stereo);
+    };
+
+    double baseline = measure("bounds checked", stems, mix_bounds_checked);
+    double scalar = measure("scalar kernel", stems, scalar_kernel);
+    double simd = measure("simd kernel", stems, simd_kernel);
+    bool matches = matches_bounds_checked(stems, scalar_kernel)
+        && matches_bounds_checked(stems, simd_kernel);
+
+    printf("Speedup over the bounds checked loop: scalar %.1fx, simd %.1fx\n",
+        baseline / scalar, baseline / simd);
+    printf("Output %s the bounds checked loop\n\n", matches ? "matches" : "DIFFERS from");
+    return matches;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(5);
+    bool matches = true;
+
+    for (int stem_length : STEM_LENGTHS) {
+        matches = run(stem_length, random) && matches;
+    }
+
+    return matches ? 0 : 1;
+}
@@ -0,0 +1,223 @@
+#include <audio-buffer.h>
+#include <mix-kernel.h>
+#include <worker-pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+/*
+ * Per-quantum cost of the stem mixdown against the stem count and the mix
+ * thread count. Stems are split into groups and mixed into partial buses
+ * on the pool, then the buses are summed, the same way StemManager::render
+ * does it. One thread always mixes straight into the output chunk.
+ *
+ * The thread counts go up to what StemManager would allow on this machine,
+ * pass a number to go higher: `mix-pool-bench 8`.
+ */
+
+namespace {
+
+// Same as in StemManager
+const size_t MIX_STEMS_PER_THREAD_MIN = 4;
+const uint32_t MIX_HELPER_THREADS_MAX = 32 / 8;
+
+const size_t STEM_COUNTS[] = { 8, 16, 32, 40 };
+const int STEM_LENGTH = 44100 * 10;
+const int QUANTA = 2000;
+const int RUNS = 5;
+
+struct stem {
+    std::mutex mutex;
+    std::vector<int16_t> data;
+    int offset;
+    float gain_l;
+    float gain_r;
+};
+
+class Mixdown {
+public:
+    Mixdown(std::vector<std::unique_ptr<stem>>& stems, uint32_t max_threads)
+        : _stems(stems)
+        , _pool(max_threads - 1)
+        , _partial_buses(std::make_unique<audio_chunk[]>(max_threads))
+        , _thread_count(1)
+    {
+    }
+
+    void set_thread_count(uint32_t count)
+    {
+        _thread_count = count;
+    }
+
+    void render(uint32_t first_sample, audio_chunk& chunk, size_t stem_count)
+    {
+        size_t groups = std::min<size_t>(_thread_count, stem_count / MIX_STEMS_PER_THREAD_MIN);
+
+        if (groups <= 1) {
+            for (size_t i = 0; i < stem_count; ++i) {
+                render_stem(*_stems[i], first_sample, chunk);
+            }
+
+            return;
+        }
+
+        auto render_group = [&](size_t group) {
+            audio_chunk& bus = _partial_buses[group];
+            memset(&bus, 0, sizeof(audio_chunk));
+
+            size_t first_stem = group * stem_count / groups;
+            size_t last_stem = (group + 1) * stem_count / groups;
+            for (size_t i = first_stem; i < last_stem; ++i) {
+                render_stem(*_stems[i], first_sample, bus);
+            }
+        };
+
+        _pool.run(groups, render_group);
+
+        for (size_t group = 0; group < groups; ++group) {
+            const audio_chunk& bus = _partial_buses[group];
+            for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+                chunk.left_channel[i] += bus.left_channel[i];
+                chunk.right_channel[i] += bus.right_channel[i];
+            }
+        }
+    }
+
+private:
+    std::vector<std::unique_ptr<stem>>& _stems;
+    WorkerPool _pool;
+    std::unique_ptr<audio_chunk[]> _partial_buses;
+    uint32_t _thread_count;
+
+    static void render_stem(stem& source, uint32_t first_sample, audio_chunk& chunk)
+    {
+        std::lock_guard lock(source.mutex);
+
+        int stem_sample = first_sample - source.offset;
+        int first_frame = std::max(0, -stem_sample);
+        int last_frame = std::min(AUDIO_CHUNK_SAMPLES, STEM_LENGTH - stem_sample);
+        if (first_frame >= last_frame) {
+            return;
+        }
+
+        MixKernel::mix_stereo(source.data.data() + 2 * (stem_sample + first_frame),
+            last_frame - first_frame, source.gain_l, source.gain_r,
+            chunk.left_channel + first_frame, chunk.right_channel + first_frame);
+    }
+};
+
+uint32_t default_max_threads()
+{
+    // StemManager::max_mix_thread_count() on this machine
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t helpers = cores > 2 ? cores - 2 : 0;
+    return std::min(helpers, MIX_HELPER_THREADS_MAX) + 1;
+}
+
+void render_quanta(Mixdown& mixdown, size_t stem_count, std::vector<audio_chunk>* output)
+{
+    audio_chunk chunk;
+    for (int quantum = 0; quantum < QUANTA; ++quantum) {
+        memset(&chunk, 0, sizeof(audio_chunk));
+        mixdown.render(quantum * AUDIO_CHUNK_SAMPLES, chunk, stem_count);
+
+        if (output) {
+            (*output)[quantum] = chunk;
+        }
+    }
+}
+
+double measure(Mixdown& mixdown, size_t stem_count)
+{
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        render_quanta(mixdown, stem_count, nullptr);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best / QUANTA;
+}
+
+// The partial buses change the summation order, so pooled output only
+// matches the serial one up to float rounding
+float max_difference(const std::vector<audio_chunk>& a, const std::vector<audio_chunk>& b)
+{
+    float difference = 0.f;
+    for (int quantum = 0; quantum < QUANTA; ++quantum) {
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            difference = std::max({ difference,
+                std::abs(a[quantum].left_channel[i] - b[quantum].left_channel[i]),
+                std::abs(a[quantum].right_channel[i] - b[quantum].right_channel[i]) });
+        }
+    }
+
+    return difference;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t max_threads = argc > 1 ? std::max(1, atoi(argv[1])) : default_max_threads();
+    std::mt19937 random(4);
+
+    std::vector<std::unique_ptr<stem>> stems;
+    for (size_t i = 0; i < STEM_COUNTS[std::size(STEM_COUNTS) - 1]; ++i) {
+        auto source = std::make_unique<stem>();
+        source->data.resize(2 * STEM_LENGTH);
+        for (int16_t& sample : source->data) {
+            sample = int16_t(random());
+        }
+
+        // Most stems start and end in the middle of a quantum
+        source->offset = random() % 20000;
+        source->gain_l = (random() % 1000) / 1000.f / 32768;
+        source->gain_r = (random() % 1000) / 1000.f / 32768;
+        stems.push_back(std::move(source));
+    }
+
+    Mixdown mixdown(stems, max_threads);
+
+    printf("%d hardware threads, %.1f s stems, ns per quantum (best of %d)\n\n",
+        std::thread::hardware_concurrency(), double(STEM_LENGTH) / AUDIO_SAMPLE_RATE, RUNS);
+    printf("stems");
+    for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+        printf(" %7u thr", threads);
+    }
+    printf("\n");
+
+    bool matches = true;
+    for (size_t stem_count : STEM_COUNTS) {
+        std::vector<audio_chunk> serial(QUANTA), pooled(QUANTA);
+        mixdown.set_thread_count(1);
+        render_quanta(mixdown, stem_count, &serial);
+
+        printf("%5zu", stem_count);
+        for (uint32_t threads = 1; threads <= max_threads; ++threads) {
+            mixdown.set_thread_count(threads);
+            printf(" %11.0f", measure(mixdown, stem_count));
+            fflush(stdout);
+
+            render_quanta(mixdown, stem_count, &pooled);
+            matches = matches && max_difference(serial, pooled) < 1e-5f;
+        }
+        printf("\n");
+    }
+
+    printf("\nPooled output %s the serial one\n", matches ? "matches" : "DIFFERS from");
+    return matches ? 0 : 1;
+}
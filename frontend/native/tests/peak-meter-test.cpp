@@ -0,0 +1,94 @@
+#include <audio-buffer.h>
+#include <peak-meter.h>
+
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+ * Checks the true peak readings against a direct polyphase upsampling of
+ * every sample, the way PeakMeter worked before it used FIRFilter.
+ */
+
+// Defined in peak-meter.cpp
+extern std::array<float, 111> RESAMPLER_TAPS;
+
+namespace {
+
+const int OVERSAMPLING = 4;
+const int PHASE_TAPS = (RESAMPLER_TAPS.size() + OVERSAMPLING - 1) / OVERSAMPLING;
+const double DESCENT_RATE = 0.99991;
+const double TOLERANCE_DB = 1e-4;
+
+class ReferenceMeter {
+public:
+    double process(const float* samples)
+    {
+        for (int i = 0; i < AUDIO_CHUNK_SAMPLES; ++i) {
+            _history.insert(_history.begin(), samples[i]);
+            _history.resize(PHASE_TAPS);
+
+            double this_peak = std::abs(samples[i]);
+            for (int p = 0; p < OVERSAMPLING; ++p) {
+                double output_sample = 0;
+                for (int j = 0; j < PHASE_TAPS; ++j) {
+                    size_t tap = OVERSAMPLING * j + p;
+                    if (tap < RESAMPLER_TAPS.size()) {
+                        output_sample += double(RESAMPLER_TAPS[tap]) * _history[j];
+                    }
+                }
+                this_peak = std::max(this_peak, std::abs(output_sample));
+            }
+
+            _peak *= DESCENT_RATE;
+            if (this_peak > _peak) {
+                _peak = this_peak;
+            }
+        }
+
+        return 20.0 * std::log10(_peak);
+    }
+
+private:
+    std::vector<double> _history = std::vector<double>(PHASE_TAPS, 0.0);
+    double _peak = 0.0;
+};
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(18);
+    std::uniform_real_distribution<float> noise(-1.f, 1.f);
+
+    PeakMeter meter;
+    ReferenceMeter left_reference, right_reference;
+    int errors = 0;
+
+    // Noise bursts of random levels with quiet stretches in between, so
+    // the readings both rise and decay
+    for (int i = 0; i < 2000; ++i) {
+        audio_chunk chunk;
+        float level = i % 50 < 10 ? noise(random) : 0.01f;
+        for (int s = 0; s < AUDIO_CHUNK_SAMPLES; ++s) {
+            chunk.left_channel[s] = level * noise(random);
+            chunk.right_channel[s] = 0.5f * level * noise(random);
+        }
+
+        meter.process(chunk);
+        double left = left_reference.process(chunk.left_channel);
+        double right = right_reference.process(chunk.right_channel);
+
+        if (std::abs(meter.left_db() - left) > TOLERANCE_DB
+            || std::abs(meter.right_db() - right) > TOLERANCE_DB) {
+            fprintf(stderr, "Chunk %d: %f/%f dB, reference %f/%f dB\n",
+                i, meter.left_db(), meter.right_db(), left, right);
+            ++errors;
+        }
+    }
+
+    printf("%d errors\n", errors);
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+#include <peak-pyramid.h>
+#include <png-encoder.h>
+#include <silence-detector.h>
+#include <waveform-renderer.h>
+
+#include <lodepng.h>
+#include <stb_vorbis.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+/*
+ * Encodes the waveform image of a stem the way StemManager renders it
+ * (4096x128) with every PngEncoder mode. COMPACT is lodepng with its
+ * default settings, which is what waveforms were encoded with before the
+ * fast modes. The fast modes' output is decoded with lodepng again and
+ * compared to the source pixels.
+ *
+ * Usage: png-encoder-bench [stem.oga]
+ */
+
+namespace {
+
+const int WIDTH = 4096;
+const int HEIGHT = 128;
+const int RUNS = 20;
+
+std::string read_file(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : GS_DEMO_STEM;
+    std::string compressed_data = read_file(path);
+
+    int channels, sample_rate;
+    short* samples;
+    int frames = stb_vorbis_decode_memory(
+        reinterpret_cast<const unsigned char*>(compressed_data.data()),
+        compressed_data.size(), &channels, &sample_rate, &samples);
+    if (frames <= 0 || channels != 2) {
+        fprintf(stderr, "Can't decode %s as a stereo stem\n", path);
+        return 1;
+    }
+
+    SilenceDetector detector;
+    detector.detect_silence(samples, frames);
+    PeakPyramid peaks;
+    peaks.build(samples, frames);
+    free(samples);
+
+    WaveformRenderer renderer(WIDTH, HEIGHT, detector);
+    renderer.set_silence_alpha(140);
+    std::vector<uint8_t> image = renderer.render_waveform(0, frames, peaks, frames);
+
+    printf("%s: %dx%d waveform\n", path, WIDTH, HEIGHT);
+
+    struct mode_info {
+        const char* name;
+        PngEncoder::Mode mode;
+    };
+
+    double compact_ms = 0;
+    bool valid = true;
+
+    for (mode_info info : { mode_info{ "COMPACT", PngEncoder::Mode::COMPACT },
+        mode_info{ "STORED", PngEncoder::Mode::STORED },
+        mode_info{ "FAST", PngEncoder::Mode::FAST } }) {
+        std::vector<uint8_t> png;
+        double best = 0;
+
+        for (int run = 0; run < RUNS; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            png = PngEncoder::encode(image.data(), WIDTH, HEIGHT, info.mode);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+            if (run == 0 || elapsed.count() < best) {
+                best = elapsed.count();
+            }
+        }
+
+        std::vector<uint8_t> decoded;
+        unsigned width, height;
+        bool matches = lodepng::decode(decoded, width, height, png) == 0
+            && width == WIDTH && height == HEIGHT && decoded == image;
+        valid = valid && matches;
+
+        if (info.mode == PngEncoder::Mode::COMPACT) {
+            compact_ms = best;
+        }
+
+        printf("%-8s %7.3f ms, %7zu bytes, %.1fx faster than COMPACT%s\n", info.name, best,
+            png.size(), compact_ms / best, matches ? "" : ", DOESN'T DECODE TO THE SOURCE");
+    }
+
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,119 @@
+#include <audio-buffer.h>
+#include <silence-detector.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <random>
+#include <vector>
+
+/*
+ * Per-quantum cost of render_stem's skip decision for a set of long stems
+ * with many silence gaps, played from start to end. Compares the linear
+ * interval scan with the binary search and the playback cursor that
+ * render_stem uses.
+ */
+
+namespace {
+
+const int STEM_COUNT = 32;
+const int GAP_COUNT = 400;
+const int SILENCE_MIN_LENGTH = 100000;
+const int RUNS = 5;
+
+bool linear_is_silent(const SilenceDetector& detector, int32_t first_sample, int32_t length)
+{
+    for (auto&& [start,end] : detector) {
+        if (first_sample >= start && first_sample <= end - length) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+double measure(const char* name, int32_t length, const std::vector<int32_t>& offsets,
+    int32_t* skipped, const std::function<bool(int stem, int32_t stem_sample)>& is_silent)
+{
+    double per_quantum = 0;
+    int32_t silent = 0;
+
+    // Best of a few runs, the playback is restarted from the beginning
+    // each time just like after a seek
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        int32_t quanta = 0;
+        silent = 0;
+
+        for (int32_t position = 0; position < length; position += AUDIO_CHUNK_SAMPLES) {
+            for (int stem = 0; stem < STEM_COUNT; ++stem) {
+                // render_stem returns early for quanta outside of the stem
+                int32_t stem_sample = position - offsets[stem];
+                if (stem_sample >= 0 && stem_sample < length) {
+                    silent += is_silent(stem, stem_sample);
+                }
+            }
+            ++quanta;
+        }
+
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        if (run == 0 || elapsed.count() / quanta < per_quantum) {
+            per_quantum = elapsed.count() / quanta;
+        }
+    }
+    printf("%-16s %9.1f ns per quantum (%d stems), %d silent\n",
+        name, per_quantum, STEM_COUNT, silent);
+    *skipped = silent;
+    return per_quantum;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(6);
+
+    // One long stem with a gap every 2.5 s or so, shared by all the stems.
+    // Each stem starts at its own offset so their lookups don't line up.
+    std::vector<int16_t> samples;
+    for (int gap = 0; gap < GAP_COUNT; ++gap) {
+        int silence = SILENCE_MIN_LENGTH + random() % 20000;
+        int burst = 1 + random() % 2000;
+        samples.insert(samples.end(), 2 * silence, 0);
+        for (int i = 0; i < 2 * burst; ++i) {
+            samples.push_back(int16_t(random()));
+        }
+    }
+
+    int32_t length = samples.size() / 2;
+    SilenceDetector detector;
+    detector.detect_silence(samples.data(), length);
+
+    std::vector<int32_t> offsets(STEM_COUNT);
+    for (int32_t& offset : offsets) {
+        offset = random() % 1000000;
+    }
+
+    printf("%d stems, %d silence gaps, %.1f minutes\n", STEM_COUNT, GAP_COUNT,
+        length / 44100.0 / 60);
+
+    int32_t expected, skipped;
+    double linear = measure("linear scan", length, offsets, &expected, [&](int, int32_t stem_sample) {
+        return linear_is_silent(detector, stem_sample, AUDIO_CHUNK_SAMPLES);
+    });
+
+    double searched = measure("binary search", length, offsets, &skipped, [&](int, int32_t stem_sample) {
+        return detector.is_silent(stem_sample, AUDIO_CHUNK_SAMPLES);
+    });
+    bool matches = skipped == expected;
+
+    std::vector<silence_cursor> cursors(STEM_COUNT, { 0, 0 });
+    double followed = measure("cursor", length, offsets, &skipped, [&](int stem, int32_t stem_sample) {
+        return detector.is_silent(stem_sample, AUDIO_CHUNK_SAMPLES, cursors[stem]);
+    });
+    matches = matches && skipped == expected;
+
+    printf("Speedup over the linear scan: binary search %.1fx, cursor %.1fx\n",
+        linear / searched, linear / followed);
+    return matches ? 0 : 1;
+}
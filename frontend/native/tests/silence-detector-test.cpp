@@ -0,0 +1,87 @@
+#include <audio-buffer.h>
+#include <silence-detector.h>
+
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/*
+ * Checks the silence lookups against the linear interval scan that
+ * render_stem used before: the binary search and the cursor must give the
+ * same answer.
+ */
+
+namespace {
+
+const int SILENCE_MIN_LENGTH = 100000;
+
+bool linear_is_silent(const SilenceDetector& detector, int32_t first_sample, int32_t length)
+{
+    for (auto&& [start,end] : detector) {
+        if (first_sample >= start && first_sample <= end - length) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Alternates silence with short bursts of noise, `gaps` times. Some of the
+// gaps are a bit too short to count as silence.
+std::vector<int16_t> make_stem(int gaps, std::mt19937& random)
+{
+    std::vector<int16_t> samples;
+    for (int gap = 0; gap < gaps; ++gap) {
+        int silence = SILENCE_MIN_LENGTH - 5000 + random() % 20000;
+        int burst = 1 + random() % 3000;
+        samples.insert(samples.end(), 2 * silence, int16_t(random() % 200));
+        for (int i = 0; i < 2 * burst; ++i) {
+            samples.push_back(int16_t(random()));
+        }
+    }
+
+    return samples;
+}
+
+} // namespace
+
+int main()
+{
+    std::mt19937 random(6);
+    std::vector<int16_t> samples = make_stem(60, random);
+    int32_t length = samples.size() / 2;
+
+    SilenceDetector detector;
+    detector.detect_silence(samples.data(), length);
+
+    int intervals = 0;
+    for ([[maybe_unused]] auto&& interval : detector) {
+        ++intervals;
+    }
+
+    int errors = 0;
+    silence_cursor cursor = { 0, 0 };
+    int32_t position = -AUDIO_CHUNK_SAMPLES * 10;
+
+    for (int i = 0; position < length + AUDIO_CHUNK_SAMPLES * 10; ++i) {
+        // Mostly sequential playback with an occasional seek
+        if (random() % 5000 == 0) {
+            position = int32_t(random() % length) - AUDIO_CHUNK_SAMPLES * 10;
+        } else {
+            position += AUDIO_CHUNK_SAMPLES;
+        }
+
+        bool expected = linear_is_silent(detector, position, AUDIO_CHUNK_SAMPLES);
+        bool searched = detector.is_silent(position, AUDIO_CHUNK_SAMPLES);
+        bool followed = detector.is_silent(position, AUDIO_CHUNK_SAMPLES, cursor);
+
+        if (searched != expected || followed != expected) {
+            fprintf(stderr, "Quantum at %d: scan %d, binary search %d, cursor %d\n",
+                position, expected, searched, followed);
+            ++errors;
+        }
+    }
+
+    printf("%d intervals, %d errors\n", intervals, errors);
+    return errors == 0 && intervals > 0 ? 0 : 1;
+}
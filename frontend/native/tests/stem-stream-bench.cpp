@@ -0,0 +1,120 @@
+#include <audio-buffer.h>
+#include <stem-stream.h>
+#include <vorbis-arena-pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+/*
+ * Seek-to-audio latency of streamed stems: the time from the mixer moving
+ * the playhead of every stem to a random position that isn't decoded yet
+ * until each of them has the first quantum at that position decoded. The stems are filled
+ * round-robin in blocks like StemManager's stream thread does. That thread
+ * also sleeps for up to 5 ms when it's idle, which comes on top of these
+ * numbers.
+ *
+ * Usage: stem-stream-bench [stem.oga]
+ */
+
+namespace {
+
+// Same as StemManager::STREAM_FILL_BLOCK_FRAMES
+const int FILL_BLOCK_FRAMES = 8192;
+const int STEM_COUNTS[] = { 1, 8, 32 };
+const int SEEKS = 200;
+
+std::string read_file(const char* path)
+{
+    std::ifstream file(path, std::ios::binary);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    return contents.str();
+}
+
+double percentile(std::vector<double> values, double fraction)
+{
+    std::sort(values.begin(), values.end());
+    return values[std::min<size_t>(values.size() * fraction, values.size() - 1)];
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const char* path = argc > 1 ? argv[1] : GS_DEMO_STEM;
+    std::string compressed_data = read_file(path);
+
+    int error = 0;
+    stb_vorbis* vorbis = stb_vorbis_open_memory(
+        reinterpret_cast<const unsigned char*>(compressed_data.data()),
+        compressed_data.size(), &error, nullptr);
+    if (vorbis == nullptr) {
+        fprintf(stderr, "Can't open %s (error %d)\n", path, error);
+        return 1;
+    }
+
+    int32_t total_frames = stb_vorbis_stream_length_in_samples(vorbis);
+    stb_vorbis_close(vorbis);
+
+    printf("%s: %.1f s, %zu KiB compressed\n", path,
+        total_frames / double(AUDIO_SAMPLE_RATE), compressed_data.size() / 1024);
+
+    auto arenas = std::make_shared<VorbisArenaPool>();
+    std::mt19937 random(8);
+
+    for (int stem_count : STEM_COUNTS) {
+        std::vector<std::unique_ptr<StemStream>> streams;
+        for (int i = 0; i < stem_count; ++i) {
+            streams.push_back(std::make_unique<StemStream>(compressed_data, total_frames, arenas));
+            if (!streams.back()->open()) {
+                fprintf(stderr, "Can't open stream %d\n", i);
+                return 1;
+            }
+        }
+
+        std::vector<double> latencies;
+        for (int seek = 0; seek < SEEKS; ++seek) {
+            // Only positions that aren't decoded yet count. All the streams
+            // have the same window, so checking the first one is enough.
+            int32_t target;
+            const int16_t* data;
+            do {
+                target = random() % (total_frames - AUDIO_CHUNK_SAMPLES);
+            } while (streams[0]->acquire(target, AUDIO_CHUNK_SAMPLES, data) > 0);
+
+            auto start = std::chrono::steady_clock::now();
+
+            for (auto& stream : streams) {
+                stream->set_playhead(target);
+            }
+
+            // Round-robin until every stem can play its first quantum
+            size_t ready = 0;
+            while (ready < streams.size()) {
+                ready = 0;
+                for (auto& stream : streams) {
+                    if (stream->acquire(target, AUDIO_CHUNK_SAMPLES, data) == AUDIO_CHUNK_SAMPLES) {
+                        ++ready;
+                    } else {
+                        stream->fill(FILL_BLOCK_FRAMES);
+                    }
+                }
+            }
+
+            std::chrono::duration<double, std::milli> latency = std::chrono::steady_clock::now() - start;
+            latencies.push_back(latency.count());
+        }
+
+        printf("%2d stems: seek to audio %6.2f ms median, %6.2f ms p95, %6.2f ms max\n",
+            stem_count, percentile(latencies, 0.5), percentile(latencies, 0.95),
+            percentile(latencies, 1));
+    }
+
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <tempo.h>
+
+#include <cstdio>
+#include <vector>
+
+/*
+ * Tags that go backwards in bars or samples contribute no beats, and the
+ * valid segments around them keep theirs. Before they were skipped, the
+ * unsigned deltas wrapped and the beat grid grew by billions of beats.
+ */
+
+namespace {
+
+const uint32_t SAMPLES_PER_BAR = 88200; // 120 BPM in 4/4
+
+size_t count_beats(const Tempo& tempo, uint32_t first_sample, uint32_t last_sample)
+{
+    std::vector<beat_event> beats(1024);
+    return tempo.beats_in_range(first_sample, last_sample, beats.data(), beats.size());
+}
+
+int check(const char* name, const std::vector<tempo_tag>& tags, uint32_t last_sample,
+    size_t expected_beats)
+{
+    Tempo tempo;
+    tempo.set_varying_bpm(tags);
+
+    size_t beats = count_beats(tempo, 0, last_sample);
+    bool passed = beats == expected_beats;
+    printf("%s: %zu beats, expected %zu%s\n", name, beats, expected_beats, passed ? "" : " FAILED");
+
+    return passed ? 0 : 1;
+}
+
+} // namespace
+
+int main()
+{
+    int errors = 0;
+
+    // Two bars, then the last segment goes on past the last tag
+    errors += check("increasing", {
+        { 0, 1, 4 },
+        { 2 * SAMPLES_PER_BAR, 3, 4 },
+        { 3 * SAMPLES_PER_BAR, 4, 4 },
+    }, 3 * SAMPLES_PER_BAR, 12);
+
+    // The middle segment goes back a bar, the last one is valid again
+    errors += check("decreasing bar", {
+        { 0, 1, 4 },
+        { 2 * SAMPLES_PER_BAR, 3, 4 },
+        { 3 * SAMPLES_PER_BAR, 2, 4 },
+        { 4 * SAMPLES_PER_BAR, 3, 4 },
+    }, 3 * SAMPLES_PER_BAR, 8);
+
+    errors += check("decreasing sample", {
+        { 0, 1, 4 },
+        { 2 * SAMPLES_PER_BAR, 3, 4 },
+        { SAMPLES_PER_BAR, 4, 4 },
+    }, 2 * SAMPLES_PER_BAR, 8);
+
+    errors += check("repeated tag", {
+        { 0, 1, 4 },
+        { 0, 1, 4 },
+    }, 2 * SAMPLES_PER_BAR, 0);
+
+    return errors == 0 ? 0 : 1;
+}
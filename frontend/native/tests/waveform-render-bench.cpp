@@ -0,0 +1,156 @@
+#include <peak-pyramid.h>
+#include <silence-detector.h>
+#include <waveform-renderer.h>
+#include <worker-pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+/*
+ * Renders the waveforms of 40 stems at once, the way a session load does:
+ * every render runs on one of the scheduler's threads and shares a single
+ * column pool, falling back to its own thread when the pool is busy
+ * (try_run). Compared with the same renders done one after another without
+ * a pool, and with a single render that gets the whole pool (e.g. after a
+ * drag). Every pooled image must match its serial render byte for byte.
+ *
+ * The pool gets as many helpers as StemManager would give it on this
+ * machine, pass a number to change that: `waveform-render-bench 4`.
+ */
+
+namespace {
+
+// Same as in StemManager
+const int WAVEFORM_WIDTH = 4096;
+const int WAVEFORM_HEIGHT = 128;
+const uint32_t WAVEFORM_HELPER_THREADS = 32 / 8;
+const int BACKGROUND_THREADS = 32 / 4;
+
+const int STEM_COUNT = 40;
+const uint32_t STEM_LENGTH = 44100 * 60;
+const int RUNS = 3;
+
+struct stem {
+    SilenceDetector detector;
+    PeakPyramid peaks;
+    int32_t offset;
+};
+
+// Noise of varying loudness with a few gaps long enough to count as silence
+void make_stem(stem& target, std::mt19937& random)
+{
+    std::vector<int16_t> samples(2 * STEM_LENGTH);
+    uint32_t position = 0;
+    while (position < STEM_LENGTH) {
+        uint32_t length = std::min<uint32_t>(STEM_LENGTH - position, 20000 + random() % 200000);
+        int level = random() % 3 == 0 ? 100 : 1000 + random() % 30000;
+
+        for (uint32_t i = 0; i < 2 * length; ++i) {
+            samples[2 * position + i] = int16_t(int(random() % (2 * level + 1)) - level);
+        }
+        position += length;
+    }
+
+    target.detector.detect_silence(samples.data(), STEM_LENGTH);
+    target.peaks.build(samples.data(), STEM_LENGTH);
+    target.offset = random() % (STEM_LENGTH / 4);
+}
+
+std::vector<uint8_t> render(stem& source, uint32_t track_length, WorkerPool* pool)
+{
+    WaveformRenderer renderer(WAVEFORM_WIDTH, WAVEFORM_HEIGHT, source.detector);
+    renderer.set_silence_alpha(140);
+    renderer.set_worker_pool(pool);
+
+    return renderer.render_waveform(source.offset, track_length, source.peaks, STEM_LENGTH);
+}
+
+double best_ms(const std::function<void()>& function)
+{
+    double best = 0;
+    for (int run = 0; run < RUNS; ++run) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        if (run == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    uint32_t cores = std::thread::hardware_concurrency();
+    uint32_t helpers = argc > 1 ? atoi(argv[1])
+        : std::min<uint32_t>(cores > 1 ? cores - 1 : 0, WAVEFORM_HELPER_THREADS);
+
+    std::mt19937 random(14);
+    std::vector<std::unique_ptr<stem>> stems;
+    uint32_t track_length = 0;
+    for (int i = 0; i < STEM_COUNT; ++i) {
+        stems.push_back(std::make_unique<stem>());
+        make_stem(*stems.back(), random);
+        track_length = std::max(track_length, stems.back()->offset + STEM_LENGTH);
+    }
+
+    printf("%d stems of %.0f s, %dx%d, %u hardware threads, %u pool helpers, %d scheduler threads\n",
+        STEM_COUNT, double(STEM_LENGTH) / 44100, WAVEFORM_WIDTH, WAVEFORM_HEIGHT, cores, helpers,
+        BACKGROUND_THREADS);
+
+    std::vector<std::vector<uint8_t>> serial(STEM_COUNT), pooled(STEM_COUNT);
+    double serial_ms = best_ms([&] {
+        for (int i = 0; i < STEM_COUNT; ++i) {
+            serial[i] = render(*stems[i], track_length, nullptr);
+        }
+    });
+
+    WorkerPool pool(helpers);
+    double concurrent_ms = best_ms([&] {
+        std::atomic<int> next_stem(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < BACKGROUND_THREADS; ++t) {
+            threads.emplace_back([&] {
+                int i;
+                while ((i = next_stem++) < STEM_COUNT) {
+                    pooled[i] = render(*stems[i], track_length, &pool);
+                }
+            });
+        }
+
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    });
+
+    bool matches = true;
+    for (int i = 0; i < STEM_COUNT; ++i) {
+        matches = matches && pooled[i] == serial[i];
+    }
+
+    std::vector<uint8_t> single;
+    double single_serial_ms = best_ms([&] { single = render(*stems[0], track_length, nullptr); });
+    double single_pooled_ms = best_ms([&] { single = render(*stems[0], track_length, &pool); });
+    matches = matches && single == serial[0];
+
+    printf("40 stems, serial          %8.1f ms\n", serial_ms);
+    printf("40 stems, concurrent+pool %8.1f ms  (%.1fx)\n", concurrent_ms, serial_ms / concurrent_ms);
+    printf("1 stem, serial            %8.1f ms\n", single_serial_ms);
+    printf("1 stem, pool              %8.1f ms  (%.1fx)\n", single_pooled_ms,
+        single_serial_ms / single_pooled_ms);
+    printf("Pooled images %s the serial ones\n", matches ? "match" : "DIFFER from");
+
+    return matches ? 0 : 1;
+}
@@ -10,6 +10,7 @@ interface GlissandoModule extends EmscriptenModule {
   getGlobalMixer: () => NativeMixer;
   VectorTempoTag: typeof CppVector<TempoTag>;
   VectorStemInfo: typeof CppVector<StemInfo>;
+  VectorTaskClassStats: typeof CppVector<TaskClassStats>;
 }
 
 // Corresponding definition in frontend/native/include/stem-manager.h
@@ -36,6 +37,19 @@ interface TempoTag {
   timeSignatureNumerator: number;
 }
 
+// Corresponding definition in frontend/native/include/task-scheduler.h
+interface TaskClassStats {
+  name: string;
+  queued: number;
+  running: number;
+  completed: number;
+  cancelled: number;
+  coalesced: number;
+  averageWaitMs: number;
+  averageRunMs: number;
+  maxRunMs: number;
+}
+
 declare class EmscriptenDisposable {
   delete: () => void;
 }
@@ -67,6 +81,7 @@ interface NativeMixer {
   isMetronomeEnabled: () => boolean;
   setMetronomeGainDb: (decibels: number) => void;
   getMetronomeGainDb: () => number;
+  setMetronomeSound: (barStart: boolean, samples: Float32Array) => void;
   setTrackBpm: (bpm: number, timeSignatureNumerator?: number) => void;
   setTrackVaryingBpm: (tags: CppVector<TempoTag>) => void;
   getTrackBpm: () => number;
@@ -79,12 +94,29 @@ interface NativeMixer {
   updateStemInfo: (info: CppVector<StemInfo>) => void;
   getWaveformOrdinal: (stemId: number) => number;
   getWaveformDataUri: (stemId: number) => string;
+  getWaveformImage: (stemId: number) => Uint8Array;
+  getWaveformWidth: () => number;
+  getWaveformHeight: () => number;
   toggleMute: (stemId: number) => void;
   toggleSolo: (stemId: number) => void;
   unmuteAll: () => void;
   isStemMuted: (stemId: number) => boolean;
   isStemSoloed: (stemId: number) => boolean;
   getLimiterReductionDb: () => number;
+  setLimiterLookaheadEnabled: (enabled: boolean) => void;
+  isLimiterLookaheadEnabled: () => boolean;
+  setLimiterStereoLinked: (linked: boolean) => void;
+  isLimiterStereoLinked: () => boolean;
+  getLimiterLatencySamples: () => number;
+  setMixThreadCount: (count: number) => void;
+  getMixThreadCount: () => number;
+  getMaxMixThreadCount: () => number;
+  setStreamingEnabled: (enabled: boolean) => void;
+  isStreamingEnabled: () => boolean;
+  getBackgroundQueueDepth: () => number;
+  getBackgroundTaskStats: () => CppVector<TaskClassStats>;
+  getBufferDepth: () => number;
+  getBufferDepthReason: () => string;
 }
 
 type FormType = { bar: number; name: string; }[];
@@ -70,13 +70,20 @@ const WaveformTile = styled(InstrumentTile)(() => ({
   flexGrow: 1,
 }));
 
-const WaveformView = withSeeking(styled('img')(() => ({
+const WaveformView = withSeeking(styled('div')(() => ({
   position: 'absolute',
   width: '100%',
   height: '100%',
   userSelect: 'none',
 })));
 
+const WaveformCanvas = styled('canvas')(() => ({
+  display: 'block',
+  width: '100%',
+  height: '100%',
+  pointerEvents: 'none',
+}));
+
 const WaveformLoader = styled('div')(({ theme }) => ({
   display: 'flex',
   alignItems: 'center',
@@ -108,17 +115,34 @@ interface EditorTrackProps {
 function EditorTrack(props: EditorTrackProps) {
   const [ native, ] = useNative();
   const trackTileRef = useRef<HTMLDivElement>(null);
+  const waveformCanvasRef = useRef<HTMLCanvasElement>(null);
   const waveformOrdinal = native!.getWaveformOrdinal(props.stemData.id);
 
-  const waveformDataUri = useMemo(() => {
+  const waveformImage = useMemo(() => {
     waveformOrdinal; // to bypass unnecessary dependency warning
-    return native!.getWaveformDataUri(props.stemData.id)
+
+    // The view points into wasm memory and is only valid until the next call,
+    // so the pixels are copied out right away
+    const pixels = native!.getWaveformImage(props.stemData.id);
+    if (pixels.length === 0) return null;
+
+    return new ImageData(
+      new Uint8ClampedArray(pixels), native!.getWaveformWidth(), native!.getWaveformHeight());
   }, [native, waveformOrdinal, props.stemData.id]);
 
+  useEffect(() => {
+    const canvas = waveformCanvasRef.current;
+    if (!canvas || !waveformImage) return;
+
+    canvas.width = waveformImage.width;
+    canvas.height = waveformImage.height;
+    canvas.getContext('2d')?.putImageData(waveformImage, 0, 0);
+  }, [waveformImage]);
+
   const waveformView = useMemo(() => {
-    if (waveformDataUri.length > 0) return <WaveformView draggable={false} src={waveformDataUri} />;
+    if (waveformImage) return <WaveformView draggable={false}><WaveformCanvas ref={waveformCanvasRef} /></WaveformView>;
     else return <WaveformLoader><div>Przetwarzanie...</div></WaveformLoader>;
-  }, [waveformDataUri]);
+  }, [waveformImage]);
 
   const handleMute = useCallback(() => {
     native!.toggleMute(props.stemData.id);